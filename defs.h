@@ -7,6 +7,11 @@
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <stdint.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define USE_X86_SIMD
+#endif
 #ifdef WIN64
     #include <windows.h>
 #else
@@ -20,6 +25,12 @@
 // define bitboard data type
 #define U64 unsigned long long
 
+// slider attacks backend: magic bitboards unless a table free one
+// is selected at build time (-DHYPERBOLA_SLIDERS or -DKOGGE_STONE_SLIDERS)
+#if !defined(HYPERBOLA_SLIDERS) && !defined(KOGGE_STONE_SLIDERS)
+    #define MAGIC_SLIDERS
+#endif
+
 // FEN dedug positions
 #define empty_board "8/8/8/8/8/8/8/8 b - - "
 #define start_position "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 "
@@ -37,6 +48,15 @@
 #define MAX(a,b) ((a > b) ? a : b)
 #define MIN(a,b) ((a > b) ? b : a)
 
+// pack middle game & endgame scores into a single int (endgame in the upper half)
+#define S(mg, eg) ((int)((unsigned int)(eg) << 16) + (mg))
+
+// unpack middle game score
+#define mg_score(score) ((int16_t)(uint16_t)(unsigned int)(score))
+
+// unpack endgame score (rounding compensates for the borrow of a negative mg half)
+#define eg_score(score) ((int16_t)(uint16_t)(((unsigned int)(score) + 0x8000) >> 16))
+
 enum {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING};
 
 // board squares
@@ -57,7 +77,11 @@ uint32_t reduce_hash(uint32_t x, uint32_t N)
 }
 
 // encode pieces
-enum { P, N, B, R, Q, K, p, n, b, r, q, k };
+enum { P, N, B, R, Q, K, p, n, b, r, q, k, no_piece };
+
+// get piece type (PAWN..KING) & color of the piece
+#define get_piece_type(piece) ((piece) % 6)
+#define get_piece_color(piece) ((piece) / 6)
 
 int PieceToPieceType[12] = {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING};
 char* PieceToPieceTypeString[12] = {"PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING", "PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING"};
@@ -164,13 +188,17 @@ U64 generate_magic_number()
 #define get_bit(bitboard, square) ((bitboard) & (1ULL << (square)))
 #define pop_bit(bitboard, square) ((bitboard) &= ~(1ULL << (square)))
 
-// count bits within a bitboard (Brian Kernighan's way)
+// count bits within a bitboard
 static inline int count_bits(U64 bitboard)
 {
+#ifdef __GNUC__
+    // hardware/compiler population count
+    return __builtin_popcountll(bitboard);
+#else
     // bit counter
     int count = 0;
     
-    // consecutively reset least significant 1st bit
+    // consecutively reset least significant 1st bit (Brian Kernighan's way)
     while (bitboard)
     {
         // increment count
@@ -182,6 +210,7 @@ static inline int count_bits(U64 bitboard)
     
     // return bit count
     return count;
+#endif
 }
 
 // get least significant 1st bit index
@@ -190,8 +219,13 @@ static inline int get_ls1b_index(U64 bitboard)
     // make sure bitboard is not 0
     if (bitboard)
     {
+#ifdef __GNUC__
+        // count trailing zeros
+        return __builtin_ctzll(bitboard);
+#else
         // count trailing bits before LS1B
         return count_bits((bitboard & -bitboard) - 1);
+#endif
     }
     
     //otherwise
@@ -212,6 +246,12 @@ const U64 not_hg_file = 4557430888798830399ULL;
 // not AB file constant
 const U64 not_ab_file = 18229723555195321596ULL;
 
+// shift bitboard by one square (white pawns move north)
+#define north_one(bitboard) ((bitboard) >> 8)
+#define south_one(bitboard) ((bitboard) << 8)
+#define east_one(bitboard) (((bitboard) << 1) & not_a_file)
+#define west_one(bitboard) (((bitboard) >> 1) & not_h_file)
+
 // bishop relevant occupancy bit count for every square on board
 const int bishop_relevant_bits[64] = {
     6, 5, 5, 5, 5, 5, 5, 6, 
@@ -586,45 +626,52 @@ U64 rook_attacks_on_the_fly(int square, U64 block)
     return attacks;
 }
 
+// move flags (promoted pieces use their own piece codes)
+enum { MOVE_DOUBLE = 12, MOVE_ENPASSANT, MOVE_CASTLING };
+
 // encode move
-#define encode_move(source, target, piece, promoted, capture, double, enpassant, castling) \
-    (source) |          \
-    (target << 6) |     \
-    (piece << 12) |     \
-    (promoted << 16) |  \
-    (capture << 20) |   \
-    (double << 21) |    \
-    (enpassant << 22) | \
-    (castling << 23)    \
+#define encode_move(source, target, flag) \
+    ((source) |          \
+    ((target) << 6) |    \
+    ((flag) << 12))
     
 // extract source square
-#define get_move_source(move) (move & 0x3f)
+#define get_move_source(move) ((move) & 0x3f)
 
 // extract target square
-#define get_move_target(move) ((move & 0xfc0) >> 6)
+#define get_move_target(move) (((move) & 0xfc0) >> 6)
 
-// extract piece
-#define get_move_piece(move) ((move & 0xf000) >> 12)
+// extract move flag
+#define get_move_flag(move) (((move) & 0xf000) >> 12)
 
 // extract promoted piece
-#define get_move_promoted(move) ((move & 0xf0000) >> 16)
-
-// extract capture flag
-#define get_move_capture(move) (move & 0x100000)
+#define get_move_promoted(move) ((get_move_flag(move) < MOVE_DOUBLE) ? get_move_flag(move) : 0)
 
 // extract double pawn push flag
-#define get_move_double(move) (move & 0x200000)
+#define get_move_double(move) (get_move_flag(move) == MOVE_DOUBLE)
 
 // extract enpassant flag
-#define get_move_enpassant(move) (move & 0x400000)
+#define get_move_enpassant(move) (get_move_flag(move) == MOVE_ENPASSANT)
 
 // extract castling flag
-#define get_move_castling(move) (move & 0x800000)
+#define get_move_castling(move) (get_move_flag(move) == MOVE_CASTLING)
+
+// extract piece (moving piece is read from the board, so before the move is made)
+#define get_move_piece(move) piece_on(get_move_source(move))
+
+// extract capture flag (read from the board, so before the move is made)
+#define get_move_capture(move) (get_move_enpassant(move) || piece_on(get_move_target(move)) != no_piece)
+
+// move list entry
+typedef struct {
+    uint16_t move;  // 16 bit move
+    int16_t score;  // move ordering score
+} scored_move;
 
 // move list structure
 typedef struct {
     // moves
-    int moves[256];
+    scored_move moves[256];
     
     // move count
     int count;
@@ -0,0 +1,241 @@
+/**********************************\
+ ==================================
+
+        Offline magic search
+
+ ==================================
+\**********************************/
+
+/*
+    Searches every square for a magic number using one index bit less
+    than the current table in defs.h. Fewer bits are possible where
+    occupancies with equal attacks share an index (constructive
+    collisions). All threads work on the same square, the first magic
+    found wins. Squares without a denser magic keep the current one.
+
+    The tables are printed to stdout ready to replace the ones in defs.h,
+    run it again on the new tables to go one more bit down.
+
+    usage: magics [threads] [milliseconds per square]
+*/
+
+#include <pthread.h>
+#include "defs.h"
+
+// search job of a single square
+typedef struct {
+    U64 mask;               // relevant occupancy mask
+    int bits;               // magic index bits to search for
+    int variations;         // number of occupancy variations
+    U64 occupancies[4096];  // occupancy variations
+    U64 attacks[4096];      // attacks of every occupancy variation
+    long deadline;          // give up time
+    int found;              // magic number found
+    U64 magic;              // found magic number
+    pthread_mutex_t lock;   // guards found magic
+} magic_job;
+
+// worker thread arguments
+typedef struct {
+    magic_job *job;
+    U64 seed;
+} magic_worker_args;
+
+// current time in milliseconds
+static long time_ms()
+{
+    struct timeval time_value;
+    gettimeofday(&time_value, NULL);
+    return time_value.tv_sec * 1000 + time_value.tv_usec / 1000;
+}
+
+// xorshift* pseudo random numbers (every thread has its own state)
+static U64 random_U64(U64 *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 2685821657736338717ULL;
+}
+
+// try sparse random magic candidates until one of the threads finds a magic or time is up
+static void *magic_worker(void *arg)
+{
+    magic_worker_args *args = arg;
+    magic_job *job = args->job;
+    U64 state = args->seed;
+
+    // attacks stored at magic index & the candidate that stored them
+    static __thread U64 used_attacks[4096];
+    static __thread unsigned int used_by[4096];
+    unsigned int candidate = 0;
+
+    while (!__atomic_load_n(&job->found, __ATOMIC_RELAXED))
+    {
+        // check the clock every now & then
+        if ((++candidate & 1023) == 0 && time_ms() > job->deadline)
+            break;
+
+        // sparse magic candidate
+        U64 magic = random_U64(&state) & random_U64(&state) & random_U64(&state);
+
+        // skip inappropriate magic numbers
+        if (count_bits((job->mask * magic) & 0xFF00000000000000ULL) < 6) continue;
+
+        // test magic index of every occupancy variation
+        int fail = 0;
+
+        for (int index = 0; !fail && index < job->variations; index++)
+        {
+            int magic_index = (int)((job->occupancies[index] * magic) >> (64 - job->bits));
+
+            // first occupancy on this index
+            if (used_by[magic_index] != candidate)
+            {
+                used_by[magic_index] = candidate;
+                used_attacks[magic_index] = job->attacks[index];
+            }
+
+            // destructive collision
+            else if (used_attacks[magic_index] != job->attacks[index])
+                fail = 1;
+        }
+
+        // magic number works
+        if (!fail)
+        {
+            pthread_mutex_lock(&job->lock);
+
+            if (!job->found)
+                job->magic = magic, __atomic_store_n(&job->found, 1, __ATOMIC_RELAXED);
+
+            pthread_mutex_unlock(&job->lock);
+        }
+    }
+
+    return NULL;
+}
+
+// search magic number of the square with the given index bits on all threads
+static int search_magic(magic_job *job, int square, int slider, int bits, int threads, long budget)
+{
+    job->mask = (slider == bishop) ? mask_bishop_attacks(square) : mask_rook_attacks(square);
+    job->bits = bits;
+    job->variations = 1 << count_bits(job->mask);
+    job->deadline = time_ms() + budget;
+    job->found = 0;
+
+    // init occupancy variations (carry rippler over mask subsets) & their attacks
+    U64 occupancy = 0ULL;
+
+    for (int index = 0; index < job->variations; index++)
+    {
+        job->occupancies[index] = occupancy;
+        occupancy = (occupancy - job->mask) & job->mask;
+        job->attacks[index] = (slider == bishop) ? bishop_attacks_on_the_fly(square, job->occupancies[index]) :
+                                                   rook_attacks_on_the_fly(square, job->occupancies[index]);
+    }
+
+    pthread_t workers[threads];
+    magic_worker_args args[threads];
+
+    // run workers
+    for (int thread = 0; thread < threads; thread++)
+    {
+        args[thread].job = job;
+        args[thread].seed = 0x9E3779B97F4A7C15ULL * (square * 64 + thread + 1) ^ time_ms();
+        pthread_create(&workers[thread], NULL, magic_worker, &args[thread]);
+    }
+
+    for (int thread = 0; thread < threads; thread++)
+        pthread_join(workers[thread], NULL);
+
+    return job->found;
+}
+
+// print relevant bits table in defs.h format
+static void print_bits(const char *name, int bits[64])
+{
+    printf("const int %s[64] = {\n", name);
+
+    for (int rank = 0; rank < 8; rank++)
+    {
+        printf("    ");
+
+        for (int file = 0; file < 8; file++)
+            printf("%d%s", bits[rank * 8 + file], (rank * 8 + file < 63) ? ", " : "");
+
+        printf("\n");
+    }
+
+    printf("};\n\n");
+}
+
+// print magic numbers table in defs.h format
+static void print_magics(const char *name, U64 magics[64])
+{
+    printf("U64 %s[64] = {\n", name);
+
+    for (int square = 0; square < 64; square++)
+        printf("    0x%llxULL%s\n", magics[square], (square < 63) ? "," : "");
+
+    printf("};\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = (argc > 1) ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long budget = (argc > 2) ? atol(argv[2]) : 1000;
+
+    if (threads < 1) threads = 1;
+
+    // shared by all workers, too big for the stack
+    static magic_job job;
+    pthread_mutex_init(&job.lock, NULL);
+
+    int bits[2][64];
+    U64 magics[2][64];
+    long entries[2][2] = {{0, 0}, {0, 0}};
+
+    fprintf(stderr, "searching on %d threads, %ld ms per square\n", threads, budget);
+
+    // loop over sliders & squares
+    for (int slider = rook; slider <= bishop; slider++)
+    {
+        for (int square = 0; square < 64; square++)
+        {
+            // current table
+            bits[slider][square] = (slider == bishop) ? bishop_relevant_bits[square] : rook_relevant_bits[square];
+            magics[slider][square] = (slider == bishop) ? bishop_magic_numbers[square] : rook_magic_numbers[square];
+            entries[slider][0] += 1 << bits[slider][square];
+
+            // one index bit less
+            if (search_magic(&job, square, slider, bits[slider][square] - 1, threads, budget))
+            {
+                bits[slider][square]--;
+                magics[slider][square] = job.magic;
+            }
+
+            entries[slider][1] += 1 << bits[slider][square];
+
+            fprintf(stderr, "%s %s: %d bits%s\n", (slider == bishop) ? "bishop" : "rook",
+                    square_to_coordinates[square], bits[slider][square], job.found ? " (one less)" : "");
+        }
+    }
+
+    fprintf(stderr, "rook table entries: %ld -> %ld\n", entries[rook][0], entries[rook][1]);
+    fprintf(stderr, "bishop table entries: %ld -> %ld\n", entries[bishop][0], entries[bishop][1]);
+
+    // print tables for defs.h
+    printf("// bishop relevant occupancy bit count for every square on board\n");
+    print_bits("bishop_relevant_bits", bits[bishop]);
+    printf("// rook relevant occupancy bit count for every square on board\n");
+    print_bits("rook_relevant_bits", bits[rook]);
+    printf("// rook magic numbers\n");
+    print_magics("rook_magic_numbers", magics[rook]);
+    printf("// bishop magic numbers\n");
+    print_magics("bishop_magic_numbers", magics[bishop]);
+
+    return 0;
+}
@@ -1,10 +1,21 @@
 #include "defs.h"
 
-// piece bitboards
-U64 bitboards[12];
+// piece bitboards in exactly one cache line
+typedef struct {
+    U64 by_type[6];     // piece type bitboards (both colors)
+    U64 by_color[2];    // color occupancy bitboards
+} __attribute__((aligned(64))) position_bitboards;
+
+position_bitboards pos;
+
+// bitboard of the given piece
+#define pieces(piece) (pos.by_type[get_piece_type(piece)] & pos.by_color[get_piece_color(piece)])
+
+// occupancy of both colors
+#define occupied() (pos.by_color[white] | pos.by_color[black])
 
-// occupancy bitboards
-U64 occupancies[3];
+// piece on every square (mailbox)
+uint8_t board[64];
 
 // side to move
 int side;
@@ -218,6 +229,38 @@ static void communicate() {
  ==================================
 \**********************************/
 
+// get piece on the given square (no_piece on empty square)
+static inline int piece_on(int square)
+{
+    return board[square];
+}
+
+// put piece on the given empty square
+static inline void put_piece(int piece, int square)
+{
+    set_bit(pos.by_type[get_piece_type(piece)], square);
+    set_bit(pos.by_color[get_piece_color(piece)], square);
+    board[square] = piece;
+}
+
+// remove piece from the given square
+static inline void remove_piece(int piece, int square)
+{
+    pop_bit(pos.by_type[get_piece_type(piece)], square);
+    pop_bit(pos.by_color[get_piece_color(piece)], square);
+    board[square] = no_piece;
+}
+
+// move piece from source square to the empty target square
+static inline void move_piece(int piece, int source_square, int target_square)
+{
+    U64 source_target = (1ULL << source_square) | (1ULL << target_square);
+    
+    pos.by_type[get_piece_type(piece)] ^= source_target;
+    pos.by_color[get_piece_color(piece)] ^= source_target;
+    board[source_square] = no_piece;
+    board[target_square] = piece;
+}
 
 
 /**********************************\
@@ -282,7 +325,7 @@ U64 generate_hash_key()
     for (int piece = P; piece <= k; piece++)
     {
         // init piece bitboard copy
-        bitboard = bitboards[piece];
+        bitboard = pieces(piece);
         
         // loop over the pieces within a bitboard
         while (bitboard)
@@ -376,23 +419,14 @@ void print_board()
             if (!file)
                 printf("  %d ", 8 - rank);
             
-            // define piece variable
-            int piece = -1;
-            
-            // loop over all piece bitboards
-            for (int bb_piece = P; bb_piece <= k; bb_piece++)
-            {
-                // if there is a piece on current square
-                if (get_bit(bitboards[bb_piece], square))
-                    // get piece code
-                    piece = bb_piece;
-            }
+            // init piece
+            int piece = piece_on(square);
             
             // print different piece set depending on OS
             #ifdef WIN64
-                printf(" %c", (piece == -1) ? '.' : ascii_pieces[piece]);
+                printf(" %c", (piece == no_piece) ? '.' : ascii_pieces[piece]);
             #else
-                printf(" %s", (piece == -1) ? "." : unicode_pieces[piece]);
+                printf(" %s", (piece == no_piece) ? "." : unicode_pieces[piece]);
             #endif
         }
         
@@ -422,11 +456,11 @@ void print_board()
 // parse FEN string
 void parse_fen(char *fen)
 {
-    // reset board position (bitboards)
-    memset(bitboards, 0ULL, sizeof(bitboards));
+    // reset board position & occupancies (bitboards)
+    memset(&pos, 0, sizeof(pos));
     
-    // reset occupancies (bitboards)
-    memset(occupancies, 0ULL, sizeof(occupancies));
+    // reset mailbox
+    memset(board, no_piece, sizeof(board));
     
     // reset game state variables
     side = 0;
@@ -454,8 +488,8 @@ void parse_fen(char *fen)
                 // init piece type
                 int piece = char_pieces[*fen];
                 
-                // set piece on corresponding bitboard
-                set_bit(bitboards[piece], square);
+                // set piece on corresponding bitboards & mailbox
+                put_piece(piece, square);
                 
                 // increment pointer to FEN string
                 fen++;
@@ -467,20 +501,8 @@ void parse_fen(char *fen)
                 // init offset (convert char 0 to int 0)
                 int offset = *fen - '0';
                 
-                // define piece variable
-                int piece = -1;
-                
-                // loop over all piece bitboards
-                for (int bb_piece = P; bb_piece <= k; bb_piece++)
-                {
-                    // if there is a piece on current square
-                    if (get_bit(bitboards[bb_piece], square))
-                        // get piece code
-                        piece = bb_piece;
-                }
-                
                 // on empty current square
-                if (piece == -1)
+                if (board[square] == no_piece)
                     // decrement file
                     file--;
                 
@@ -541,20 +563,6 @@ void parse_fen(char *fen)
     else
         enpassant = no_sq;
     
-    // loop over white pieces bitboards
-    for (int piece = P; piece <= K; piece++)
-        // populate white occupancy bitboard
-        occupancies[white] |= bitboards[piece];
-    
-    // loop over black pieces bitboards
-    for (int piece = p; piece <= k; piece++)
-        // populate white occupancy bitboard
-        occupancies[black] |= bitboards[piece];
-    
-    // init all occupancies
-    occupancies[both] |= occupancies[white];
-    occupancies[both] |= occupancies[black];
-    
     // init hash key
     hash_key = generate_hash_key();
 }
@@ -602,12 +610,28 @@ U64 bishop_masks[64];
 // rook attack masks
 U64 rook_masks[64];
 
+#ifdef MAGIC_SLIDERS
+// slider attack tables, every square takes 1 << relevant bits entries
+// (sized for the full relevant occupancy bit counts)
+U64 bishop_attacks_table[5248];
+U64 rook_attacks_table[102400];
+
 // bishop attacks table [square][occupancies]
-U64 bishop_attacks[64][512];
+U64 *bishop_attacks[64];
 
 // rook attacks rable [square][occupancies]
-U64 rook_attacks[64][4096];
+U64 *rook_attacks[64];
+#endif
 
+// lines through a square excluding the square itself [square]
+U64 file_masks_ex[64], rank_masks_ex[64], diagonal_masks_ex[64], anti_diagonal_masks_ex[64];
+
+
+// squares between two squares on a common line [square][square]
+U64 between_squares[64][64];
+
+// whole line through two squares on a common line [square][square]
+U64 line_squares[64][64];
 
 // init leaper pieces attacks
 void init_leapers_attacks()
@@ -676,14 +700,14 @@ U64 find_magic_number(int square, int relevant_bits, int bishop)
     // init attack mask for a current piece
     U64 attack_mask = bishop ? mask_bishop_attacks(square) : mask_rook_attacks(square);
     
-    // init occupancy indicies
-    int occupancy_indicies = 1 << relevant_bits;
+    // init occupancy indicies (magic index may have less bits than the mask)
+    int occupancy_indicies = 1 << count_bits(attack_mask);
     
     // loop over occupancy indicies
     for (int index = 0; index < occupancy_indicies; index++)
     {
         // init occupancies
-        occupancies[index] = set_occupancy(index, relevant_bits, attack_mask);
+        occupancies[index] = set_occupancy(index, count_bits(attack_mask), attack_mask);
         
         // init attacks
         attacks[index] = bishop ? bishop_attacks_on_the_fly(square, occupancies[index]) :
@@ -750,6 +774,11 @@ void init_magic_numbers()
 // init slider piece's attack tables
 void init_sliders_attacks(int bishop)
 {
+    #ifdef MAGIC_SLIDERS
+    // next free entry of the slider attack table
+    U64 *table = bishop ? bishop_attacks_table : rook_attacks_table;
+    #endif
+    
     // loop over 64 board squares
     for (int square = 0; square < 64; square++)
     {
@@ -757,6 +786,22 @@ void init_sliders_attacks(int bishop)
         bishop_masks[square] = mask_bishop_attacks(square);
         rook_masks[square] = mask_rook_attacks(square);
         
+        // init lines through the square for table free backends
+        for (int other = 0; other < 64; other++)
+        {
+            if (other == square) continue;
+            
+            if ((other & 7) == (square & 7)) set_bit(file_masks_ex[square], other);
+            if ((other >> 3) == (square >> 3)) set_bit(rank_masks_ex[square], other);
+            if ((other >> 3) - (other & 7) == (square >> 3) - (square & 7)) set_bit(diagonal_masks_ex[square], other);
+            if ((other >> 3) + (other & 7) == (square >> 3) + (square & 7)) set_bit(anti_diagonal_masks_ex[square], other);
+        }
+        
+        #ifdef MAGIC_SLIDERS
+        // square attacks start at the next free table entry
+        if (bishop) bishop_attacks[square] = table, table += 1 << bishop_relevant_bits[square];
+        else rook_attacks[square] = table, table += 1 << rook_relevant_bits[square];
+        
         // init current mask
         U64 attack_mask = bishop ? bishop_masks[square] : rook_masks[square];
         
@@ -796,9 +841,48 @@ void init_sliders_attacks(int bishop)
             
             }
         }
+        #endif
+    }
+}
+
+// init squares between two squares on a common line
+void init_between_squares()
+{
+    // loop over square pairs
+    for (int source_square = 0; source_square < 64; source_square++)
+    {
+        for (int target_square = 0; target_square < 64; target_square++)
+        {
+            U64 source = 1ULL << source_square, target = 1ULL << target_square;
+            
+            // squares on a common diagonal
+            if (bishop_attacks_on_the_fly(source_square, 0ULL) & target)
+            {
+                between_squares[source_square][target_square] = bishop_attacks_on_the_fly(source_square, target) &
+                                                                bishop_attacks_on_the_fly(target_square, source);
+                
+                line_squares[source_square][target_square] = (bishop_attacks_on_the_fly(source_square, 0ULL) &
+                                                              bishop_attacks_on_the_fly(target_square, 0ULL)) | source | target;
+            }
+            
+            // squares on a common rank or file
+            else if (rook_attacks_on_the_fly(source_square, 0ULL) & target)
+            {
+                between_squares[source_square][target_square] = rook_attacks_on_the_fly(source_square, target) &
+                                                                rook_attacks_on_the_fly(target_square, source);
+                
+                line_squares[source_square][target_square] = (rook_attacks_on_the_fly(source_square, 0ULL) &
+                                                              rook_attacks_on_the_fly(target_square, 0ULL)) | source | target;
+            }
+        }
     }
 }
 
+#if defined(MAGIC_SLIDERS)
+
+// slider attacks backend name
+const char *slider_backend = "magic";
+
 // get bishop attacks
 static inline U64 get_bishop_attacks(int square, U64 occupancy)
 {
@@ -855,6 +939,235 @@ static inline U64 get_queen_attacks(int square, U64 occupancy)
     return queen_attacks;
 }
 
+#elif defined(HYPERBOLA_SLIDERS)
+
+/*
+    Hyperbola quintessence
+
+    The o ^ (o - 2r) trick finds the attacks along a line towards the
+    higher squares, the same on the byte swapped board finds them towards
+    the lower squares. Byte swap only mirrors lines with one square per
+    rank, so ranks use the obstruction difference instead.
+*/
+
+// slider attacks backend name
+const char *slider_backend = "hyperbola";
+
+// attacks along a file or a diagonal
+static inline U64 line_attacks(int square, U64 occupancy, U64 line_mask)
+{
+    U64 forward = occupancy & line_mask;
+    U64 reverse = __builtin_bswap64(forward);
+    
+    forward -= 2 * (1ULL << square);
+    reverse -= 2 * __builtin_bswap64(1ULL << square);
+    
+    return (forward ^ __builtin_bswap64(reverse)) & line_mask;
+}
+
+// attacks along a rank
+static inline U64 rank_attacks(int square, U64 occupancy)
+{
+    U64 line_mask = rank_masks_ex[square];
+    
+    // blockers below & above the square
+    U64 lower = occupancy & line_mask & ((1ULL << square) - 1);
+    U64 upper = occupancy & line_mask & ~((1ULL << square) - 1);
+    
+    // nearest blocker below the square (or the lowest bit)
+    U64 nearest = 0x8000000000000000ULL >> __builtin_clzll(lower | 1);
+    
+    return (upper ^ (upper - nearest)) & line_mask;
+}
+
+// get bishop attacks
+static inline U64 get_bishop_attacks(int square, U64 occupancy)
+{
+    return line_attacks(square, occupancy, diagonal_masks_ex[square]) |
+           line_attacks(square, occupancy, anti_diagonal_masks_ex[square]);
+}
+
+// get rook attacks
+static inline U64 get_rook_attacks(int square, U64 occupancy)
+{
+    return line_attacks(square, occupancy, file_masks_ex[square]) |
+           rank_attacks(square, occupancy);
+}
+
+// get queen attacks
+static inline U64 get_queen_attacks(int square, U64 occupancy)
+{
+    return get_bishop_attacks(square, occupancy) | get_rook_attacks(square, occupancy);
+}
+
+#else
+
+/*
+    Kogge-Stone
+
+    Occluded fills spread the slider over empty squares in 3 steps
+    (1, 2 & 4 squares), one more shift turns the fill into attacks.
+    Directions towards higher squares shift left, the others right,
+    wrap masks stop east & west going rays at the board edges.
+    With AVX2 every lane fills one direction, so 4 directions are done
+    at once (8 for queens with AVX-512).
+*/
+
+#if defined(__AVX2__)
+
+// vector shift by different left (or right) amounts per lane, 64+ shifts give 0
+#define ks_shift256(x, left, right) _mm256_or_si256(_mm256_sllv_epi64(x, left), _mm256_srlv_epi64(x, right))
+
+// fill & attacks along 4 directions at once
+static inline U64 kogge_stone_attacks4(int square, U64 occupancy, __m256i left, __m256i right, __m256i wrap)
+{
+    __m256i gen = _mm256_set1_epi64x(1ULL << square);
+    __m256i pro = _mm256_and_si256(_mm256_set1_epi64x(~occupancy), wrap);
+    
+    // occluded fill by 1, 2 & 4 squares
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, ks_shift256(gen, left, right)));
+    pro = _mm256_and_si256(pro, ks_shift256(pro, left, right));
+    left = _mm256_slli_epi64(left, 1), right = _mm256_slli_epi64(right, 1);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, ks_shift256(gen, left, right)));
+    pro = _mm256_and_si256(pro, ks_shift256(pro, left, right));
+    left = _mm256_slli_epi64(left, 1), right = _mm256_slli_epi64(right, 1);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, ks_shift256(gen, left, right)));
+    
+    // one more step turns the fill into attacks
+    left = _mm256_srli_epi64(left, 2), right = _mm256_srli_epi64(right, 2);
+    gen = _mm256_and_si256(ks_shift256(gen, left, right), wrap);
+    
+    // merge the lanes
+    __m128i merged = _mm_or_si128(_mm256_castsi256_si128(gen), _mm256_extracti128_si256(gen, 1));
+    
+    return (U64)_mm_cvtsi128_si64(merged) | (U64)_mm_extract_epi64(merged, 1);
+}
+
+// get bishop attacks (SE, SW, NW, NE)
+static inline U64 get_bishop_attacks(int square, U64 occupancy)
+{
+    return kogge_stone_attacks4(square, occupancy,
+                                _mm256_setr_epi64x(9, 7, 64, 64),
+                                _mm256_setr_epi64x(64, 64, 9, 7),
+                                _mm256_setr_epi64x(not_a_file, not_h_file, not_h_file, not_a_file));
+}
+
+// get rook attacks (S, E, N, W)
+static inline U64 get_rook_attacks(int square, U64 occupancy)
+{
+    return kogge_stone_attacks4(square, occupancy,
+                                _mm256_setr_epi64x(8, 1, 64, 64),
+                                _mm256_setr_epi64x(64, 64, 8, 1),
+                                _mm256_setr_epi64x(~0ULL, not_a_file, ~0ULL, not_h_file));
+}
+
+#if defined(__AVX512F__)
+
+// slider attacks backend name
+const char *slider_backend = "kogge-stone avx512";
+
+// vector shift by different left (or right) amounts per lane, 64+ shifts give 0
+#define ks_shift512(x, left, right) _mm512_or_si512(_mm512_sllv_epi64(x, left), _mm512_srlv_epi64(x, right))
+
+// get queen attacks (all 8 directions at once)
+static inline U64 get_queen_attacks(int square, U64 occupancy)
+{
+    __m512i left = _mm512_setr_epi64(8, 1, 9, 7, 64, 64, 64, 64);
+    __m512i right = _mm512_setr_epi64(64, 64, 64, 64, 8, 1, 9, 7);
+    __m512i wrap = _mm512_setr_epi64(~0ULL, not_a_file, not_a_file, not_h_file, ~0ULL, not_h_file, not_h_file, not_a_file);
+    __m512i gen = _mm512_set1_epi64(1ULL << square);
+    __m512i pro = _mm512_and_si512(_mm512_set1_epi64(~occupancy), wrap);
+    
+    // occluded fill by 1, 2 & 4 squares
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, ks_shift512(gen, left, right)));
+    pro = _mm512_and_si512(pro, ks_shift512(pro, left, right));
+    __m512i left2 = _mm512_slli_epi64(left, 1), right2 = _mm512_slli_epi64(right, 1);
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, ks_shift512(gen, left2, right2)));
+    pro = _mm512_and_si512(pro, ks_shift512(pro, left2, right2));
+    __m512i left4 = _mm512_slli_epi64(left, 2), right4 = _mm512_slli_epi64(right, 2);
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, ks_shift512(gen, left4, right4)));
+    
+    // one more step turns the fill into attacks, then merge the lanes
+    return _mm512_reduce_or_epi64(_mm512_and_si512(ks_shift512(gen, left, right), wrap));
+}
+
+#else
+
+// slider attacks backend name
+const char *slider_backend = "kogge-stone avx2";
+
+// get queen attacks
+static inline U64 get_queen_attacks(int square, U64 occupancy)
+{
+    return get_bishop_attacks(square, occupancy) | get_rook_attacks(square, occupancy);
+}
+
+#endif
+
+#else
+
+// slider attacks backend name
+const char *slider_backend = "kogge-stone";
+
+// shift amounts [direction] (left: S, E, SE, SW, right: N, W, NW, NE)
+const int kogge_stone_shifts[8] = {8, 1, 9, 7, 8, 1, 9, 7};
+
+// fill & attacks along the given directions
+static inline U64 kogge_stone_attacks(int square, U64 occupancy, int first, int last)
+{
+    const U64 wraps[8] = { ~0ULL, not_a_file, not_a_file, not_h_file, ~0ULL, not_h_file, not_h_file, not_a_file };
+    U64 attacks = 0ULL;
+    
+    // loop over directions
+    for (int direction = first; direction <= last; direction++)
+    {
+        int shift = kogge_stone_shifts[direction];
+        U64 gen = 1ULL << square, pro = ~occupancy & wraps[direction];
+        
+        // towards higher squares
+        if (direction < 4)
+        {
+            gen |= pro & (gen << shift); pro &= pro << shift;
+            gen |= pro & (gen << 2 * shift); pro &= pro << 2 * shift;
+            gen |= pro & (gen << 4 * shift);
+            attacks |= (gen << shift) & wraps[direction];
+        }
+        
+        // towards lower squares
+        else
+        {
+            gen |= pro & (gen >> shift); pro &= pro >> shift;
+            gen |= pro & (gen >> 2 * shift); pro &= pro >> 2 * shift;
+            gen |= pro & (gen >> 4 * shift);
+            attacks |= (gen >> shift) & wraps[direction];
+        }
+    }
+    
+    return attacks;
+}
+
+// get bishop attacks
+static inline U64 get_bishop_attacks(int square, U64 occupancy)
+{
+    return kogge_stone_attacks(square, occupancy, 2, 3) | kogge_stone_attacks(square, occupancy, 6, 7);
+}
+
+// get rook attacks
+static inline U64 get_rook_attacks(int square, U64 occupancy)
+{
+    return kogge_stone_attacks(square, occupancy, 0, 1) | kogge_stone_attacks(square, occupancy, 4, 5);
+}
+
+// get queen attacks
+static inline U64 get_queen_attacks(int square, U64 occupancy)
+{
+    return kogge_stone_attacks(square, occupancy, 0, 7);
+}
+
+#endif
+
+#endif
+
 
 /**********************************\
  ==================================
@@ -867,120 +1180,412 @@ static inline U64 get_queen_attacks(int square, U64 occupancy)
 // is square current given attacked by the current given side
 static inline int is_square_attacked(int square, int side)
 {
-    // attacked by white pawns
-    if ((side == white) && (pawn_attacks[black][square] & bitboards[P])) return 1;
+    // pieces of the attacking side
+    U64 attackers = pos.by_color[side];
     
-    // attacked by black pawns
-    if ((side == black) && (pawn_attacks[white][square] & bitboards[p])) return 1;
+    // attacked by pawns
+    if (pawn_attacks[side ^ 1][square] & pos.by_type[PAWN] & attackers) return 1;
     
     // attacked by knights
-    if (knight_attacks[square] & ((side == white) ? bitboards[N] : bitboards[n])) return 1;
+    if (knight_attacks[square] & pos.by_type[KNIGHT] & attackers) return 1;
     
-    // attacked by bishops
-    if (get_bishop_attacks(square, occupancies[both]) & ((side == white) ? bitboards[B] : bitboards[b])) return 1;
+    // attacked by bishops & queens
+    if (get_bishop_attacks(square, occupied()) & (pos.by_type[BISHOP] | pos.by_type[QUEEN]) & attackers) return 1;
 
-    // attacked by rooks
-    if (get_rook_attacks(square, occupancies[both]) & ((side == white) ? bitboards[R] : bitboards[r])) return 1;    
-
-    // attacked by bishops
-    if (get_queen_attacks(square, occupancies[both]) & ((side == white) ? bitboards[Q] : bitboards[q])) return 1;
+    // attacked by rooks & queens
+    if (get_rook_attacks(square, occupied()) & (pos.by_type[ROOK] | pos.by_type[QUEEN]) & attackers) return 1;    
     
     // attacked by kings
-    if (king_attacks[square] & ((side == white) ? bitboards[K] : bitboards[k])) return 1;
+    if (king_attacks[square] & pos.by_type[KING] & attackers) return 1;
 
     // by default return false
     return 0;
 }
 
-// print attacked squares
-void print_attacked_squares(int side)
+// get bitboard of pieces of both sides attacking the given square
+static inline U64 attackers_to(int square, U64 occupancy)
 {
-    printf("\n");
+    return (pawn_attacks[black][square] & pieces(P))
+         | (pawn_attacks[white][square] & pieces(p))
+         | (knight_attacks[square] & pos.by_type[KNIGHT])
+         | (get_bishop_attacks(square, occupancy) & (pos.by_type[BISHOP] | pos.by_type[QUEEN]))
+         | (get_rook_attacks(square, occupancy) & (pos.by_type[ROOK] | pos.by_type[QUEEN]))
+         | (king_attacks[square] & pos.by_type[KING]);
+}
+
+/*
+    Per ply attack cache
+
+    Attack information of the position at the current ply is computed
+    lazily on first use and shared by check detection, move legality,
+    castling and evaluation. An entry belongs to the position with the
+    stored hash key, so it stays valid after taking moves back.
     
-    // loop over board ranks
-    for (int rank = 0; rank < 8; rank++)
+    The check info part (squares from which every piece type checks the
+    enemy king & pieces whose move discovers a check) lets the search
+    tell whether a move gives check without making it.
+*/
+
+// king info flag in the attack cache valid mask (bits 0-11 are piece attacks)
+#define KING_INFO (1 << 12)
+
+// check info flag in the attack cache valid mask
+#define CHECK_INFO (1 << 13)
+
+// attack information of a position
+typedef struct {
+    U64 key;                // hash key of the position
+    int valid;              // mask of computed entries
+    U64 checkers;           // enemy pieces giving check
+    U64 pinned;             // side to move pieces pinned to own king
+    U64 piece_attacks[12];  // squares attacked by every piece type
+    int mobility[12];       // attacked squares summed over the pieces of every type
+    U64 check_squares[6];   // squares giving check to the enemy king [piece type]
+    U64 discovered;         // side to move pieces blocking own slider checks
+    int enemy_king;         // enemy king square
+} attack_info;
+
+// search stack entry
+typedef struct {
+    attack_info attacks;        // attack cache
+    int static_eval;            // static evaluation of the node (-INFINITE in check)
+    int in_check;               // side to move is in check
+    int excluded_move;          // move skipped by a singular extension search
+    int current_move;           // move being searched (0 for a null move)
+    int moved_piece;            // piece making the current move
+    int reduction;              // late move reduction of the current move
+    uint16_t killers[2];        // quiet moves causing beta cutoffs at this ply
+    int (*continuation)[64];    // continuation history following the current move [piece][to]
+} search_stack;
+
+// search stack [ply]
+search_stack ss[MAX_PLY + 1];
+
+// get attack cache entry of the current position
+static inline attack_info *node_attacks()
+{
+    attack_info *info = &ss[ply].attacks;
+    
+    // entry belongs to another position
+    if (info->key != hash_key || !info->valid)
     {
-        // loop over board files
-        for (int file = 0; file < 8; file++)
-        {
-            // init square
-            int square = rank * 8 + file;
-            
-            // print ranks
-            if (!file)
-                printf("  %d ", 8 - rank);
-            
-            // check whether current square is attacked or not
-            printf(" %d", is_square_attacked(square, side) ? 1 : 0);
-        }
-        
-        // print new line every rank
-        printf("\n");
+        info->key = hash_key;
+        info->valid = 0;
     }
     
-    // print files
-    printf("\n     a b c d e f g h\n\n");
+    return info;
 }
 
-/*
-          binary move bits                               hexidecimal constants
-    
-    0000 0000 0000 0000 0011 1111    source square       0x3f
-    0000 0000 0000 1111 1100 0000    target square       0xfc0
-    0000 0000 1111 0000 0000 0000    piece               0xf000
-    0000 1111 0000 0000 0000 0000    promoted piece      0xf0000
-    0001 0000 0000 0000 0000 0000    capture flag        0x100000
-    0010 0000 0000 0000 0000 0000    double push flag    0x200000
-    0100 0000 0000 0000 0000 0000    enpassant flag      0x400000
-    1000 0000 0000 0000 0000 0000    castling flag       0x800000
-*/
-
+// compute checkers & pinned pieces of the side to move
+static inline void compute_king_info(attack_info *info)
+{
+    int king_square = get_ls1b_index(pieces((side == white) ? K : k));
+    U64 them = pos.by_color[side ^ 1];
+    
+    // enemy pieces attacking our king
+    info->checkers = attackers_to(king_square, occupied()) & them;
+    
+    // enemy sliders attacking our king through our pieces
+    U64 snipers = ((get_bishop_attacks(king_square, them) & (pos.by_type[BISHOP] | pos.by_type[QUEEN]))
+                |  (get_rook_attacks(king_square, them) & (pos.by_type[ROOK] | pos.by_type[QUEEN]))) & them;
+    
+    info->pinned = 0ULL;
+    
+    // loop over snipers
+    while (snipers)
+    {
+        int square = get_ls1b_index(snipers);
+        
+        // single piece in between is pinned
+        U64 blockers = between_squares[king_square][square] & occupied();
+        
+        if (blockers && !(blockers & (blockers - 1)))
+            info->pinned |= blockers & pos.by_color[side];
+        
+        pop_bit(snipers, square);
+    }
+    
+    info->valid |= KING_INFO;
+}
 
-// add move to the move list
-static inline void add_move(moves *move_list, int move)
+// get enemy pieces giving check to the side to move
+static inline U64 node_checkers()
 {
-    // strore move
-    move_list->moves[move_list->count] = move;
+    attack_info *info = node_attacks();
     
-    // increment move count
-    move_list->count++;
+    if (!(info->valid & KING_INFO))
+        compute_king_info(info);
+    
+    return info->checkers;
 }
 
-// print move (for UCI purposes)
-void print_move(int move)
+// get side to move pieces pinned to own king
+static inline U64 node_pinned()
 {
-    if (get_move_promoted(move))
-        printf("%s%s%c", square_to_coordinates[get_move_source(move)],
-                           square_to_coordinates[get_move_target(move)],
-                           promoted_pieces[get_move_promoted(move)]);
-    else
-        printf("%s%s", square_to_coordinates[get_move_source(move)],
-                           square_to_coordinates[get_move_target(move)]);
+    attack_info *info = node_attacks();
+    
+    if (!(info->valid & KING_INFO))
+        compute_king_info(info);
+    
+    return info->pinned;
 }
 
+// compute check squares & discovered check candidates of the side to move
+static inline void compute_check_info(attack_info *info)
+{
+    int king_square = get_ls1b_index(pieces((side == white) ? k : K));
+    U64 us = pos.by_color[side];
+    
+    info->enemy_king = king_square;
+    
+    // squares from which every piece type attacks the enemy king
+    info->check_squares[PAWN] = pawn_attacks[side ^ 1][king_square];
+    info->check_squares[KNIGHT] = knight_attacks[king_square];
+    info->check_squares[BISHOP] = get_bishop_attacks(king_square, occupied());
+    info->check_squares[ROOK] = get_rook_attacks(king_square, occupied());
+    info->check_squares[QUEEN] = info->check_squares[BISHOP] | info->check_squares[ROOK];
+    info->check_squares[KING] = 0ULL;
+    
+    // own sliders aiming at the enemy king through own pieces
+    U64 snipers = ((get_bishop_attacks(king_square, pos.by_color[side ^ 1]) & (pos.by_type[BISHOP] | pos.by_type[QUEEN]))
+                |  (get_rook_attacks(king_square, pos.by_color[side ^ 1]) & (pos.by_type[ROOK] | pos.by_type[QUEEN]))) & us;
+    
+    info->discovered = 0ULL;
+    
+    // loop over snipers
+    while (snipers)
+    {
+        int square = get_ls1b_index(snipers);
+        
+        // single own piece in between discovers a check when moving off the line
+        U64 blockers = between_squares[king_square][square] & occupied();
+        
+        if (blockers && !(blockers & (blockers - 1)))
+            info->discovered |= blockers & us;
+        
+        pop_bit(snipers, square);
+    }
+    
+    info->valid |= CHECK_INFO;
+}
 
-// print move list
-void print_move_list(moves *move_list)
+// does the (pseudo legal) move of the side to move give check
+static inline int gives_check(int move)
 {
-    // do nothing on empty move list
-    if (!move_list->count)
+    attack_info *info = node_attacks();
+    
+    if (!(info->valid & CHECK_INFO))
+        compute_check_info(info);
+    
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+    int flag = get_move_flag(move);
+    int king_square = info->enemy_king;
+    U64 target = 1ULL << target_square;
+    
+    // discovered check when leaving the line to the enemy king
+    if ((info->discovered & (1ULL << source_square)) && !(line_squares[king_square][source_square] & target))
+        return 1;
+    
+    // promoted piece attacks through the square the pawn has left
+    if (flag && flag < MOVE_DOUBLE)
     {
-        printf("\n     No move in the move list!\n");
-        return;
+        U64 occupancy = occupied() ^ (1ULL << source_square);
+        
+        switch (PieceToPieceType[flag])
+        {
+            case KNIGHT: return (knight_attacks[target_square] >> king_square) & 1;
+            case BISHOP: return (get_bishop_attacks(target_square, occupancy) >> king_square) & 1;
+            case ROOK: return (get_rook_attacks(target_square, occupancy) >> king_square) & 1;
+            default: return (get_queen_attacks(target_square, occupancy) >> king_square) & 1;
+        }
     }
     
-    printf("\n     move    piece     capture   double    enpass    castling\n\n");
+    // direct check
+    if (info->check_squares[PieceToPieceType[piece_on(source_square)]] & target)
+        return 1;
     
-    // loop over moves within a move list
-    for (int move_count = 0; move_count < move_list->count; move_count++)
+    // enpassant capture may discover a check through both pawn squares
+    if (flag == MOVE_ENPASSANT)
     {
-        // init move
-        int move = move_list->moves[move_count];
+        int captured_square = (side == white) ? target_square + 8 : target_square - 8;
+        U64 occupancy = (occupied() ^ (1ULL << source_square) ^ (1ULL << captured_square)) | target;
+        U64 us = pos.by_color[side];
         
-        #ifdef WIN64
-            // print move
-            printf("      %s%s%c   %c         %d         %d         %d         %d\n", square_to_coordinates[get_move_source(move)],
-                                                                                  square_to_coordinates[get_move_target(move)],
+        return ((get_bishop_attacks(king_square, occupancy) & (pos.by_type[BISHOP] | pos.by_type[QUEEN]) & us) |
+                (get_rook_attacks(king_square, occupancy) & (pos.by_type[ROOK] | pos.by_type[QUEEN]) & us)) != 0;
+    }
+    
+    // castling rook may check from its new square
+    if (flag == MOVE_CASTLING)
+    {
+        int rook_source = ((target_square & 7) == 6) ? target_square + 1 : target_square - 2;
+        int rook_target = ((target_square & 7) == 6) ? target_square - 1 : target_square + 1;
+        U64 occupancy = (occupied() ^ (1ULL << source_square) ^ (1ULL << rook_source)) | target | (1ULL << rook_target);
+        
+        return (get_rook_attacks(rook_target, occupancy) >> king_square) & 1;
+    }
+    
+    return 0;
+}
+
+// get squares attacked by the given piece type
+static inline U64 node_piece_attacks(int piece)
+{
+    attack_info *info = node_attacks();
+    
+    // already computed
+    if (info->valid & (1 << piece))
+        return info->piece_attacks[piece];
+    
+    U64 bitboard = pieces(piece), attacks = 0ULL;
+    int mobility = 0;
+    
+    // pawn attacks set-wise
+    if (piece == P)
+        attacks = east_one(north_one(bitboard)) | west_one(north_one(bitboard));
+    
+    else if (piece == p)
+        attacks = east_one(south_one(bitboard)) | west_one(south_one(bitboard));
+    
+    // other pieces square by square
+    else while (bitboard)
+    {
+        int square = get_ls1b_index(bitboard);
+        U64 piece_attacks = 0ULL;
+        
+        switch (PieceToPieceType[piece])
+        {
+            case KNIGHT: piece_attacks = knight_attacks[square]; break;
+            case BISHOP: piece_attacks = get_bishop_attacks(square, occupied()); break;
+            case ROOK: piece_attacks = get_rook_attacks(square, occupied()); break;
+            case QUEEN: piece_attacks = get_queen_attacks(square, occupied()); break;
+            case KING: piece_attacks = king_attacks[square]; break;
+        }
+        
+        // squares attacked by more pieces of the type count for each of them
+        attacks |= piece_attacks;
+        mobility += count_bits(piece_attacks);
+        
+        pop_bit(bitboard, square);
+    }
+    
+    info->piece_attacks[piece] = attacks;
+    info->mobility[piece] = mobility;
+    info->valid |= 1 << piece;
+    
+    return attacks;
+}
+
+// get number of squares attacked by every piece of the given type summed up
+static inline int node_piece_mobility(int piece)
+{
+    node_piece_attacks(piece);
+    
+    return node_attacks()->mobility[piece];
+}
+
+// get squares attacked by the given side
+static inline U64 node_side_attacks(int side)
+{
+    U64 attacks = 0ULL;
+    
+    for (int piece = P + side * 6; piece <= K + side * 6; piece++)
+        attacks |= node_piece_attacks(piece);
+    
+    return attacks;
+}
+
+// print attacked squares
+void print_attacked_squares(int side)
+{
+    printf("\n");
+    
+    // loop over board ranks
+    for (int rank = 0; rank < 8; rank++)
+    {
+        // loop over board files
+        for (int file = 0; file < 8; file++)
+        {
+            // init square
+            int square = rank * 8 + file;
+            
+            // print ranks
+            if (!file)
+                printf("  %d ", 8 - rank);
+            
+            // check whether current square is attacked or not
+            printf(" %d", is_square_attacked(square, side) ? 1 : 0);
+        }
+        
+        // print new line every rank
+        printf("\n");
+    }
+    
+    // print files
+    printf("\n     a b c d e f g h\n\n");
+}
+
+/*
+          binary move bits                   hexidecimal constants
+    
+    0000 0000 0011 1111    source square       0x3f
+    0000 1111 1100 0000    target square       0xfc0
+    1111 0000 0000 0000    move flag           0xf000
+    
+    move flag: 0 - normal move, N..Q & n..q - promoted piece,
+               12 - double push, 13 - enpassant, 14 - castling
+    
+    moving piece & captured piece are looked up on the board
+*/
+
+
+// add move to the move list
+static inline void add_move(moves *move_list, int move)
+{
+    // strore move
+    move_list->moves[move_list->count].move = move;
+    move_list->moves[move_list->count].score = 0;
+    
+    // increment move count
+    move_list->count++;
+}
+
+// print move (for UCI purposes)
+void print_move(int move)
+{
+    if (get_move_promoted(move))
+        printf("%s%s%c", square_to_coordinates[get_move_source(move)],
+                           square_to_coordinates[get_move_target(move)],
+                           promoted_pieces[get_move_promoted(move)]);
+    else
+        printf("%s%s", square_to_coordinates[get_move_source(move)],
+                           square_to_coordinates[get_move_target(move)]);
+}
+
+
+// print move list
+void print_move_list(moves *move_list)
+{
+    // do nothing on empty move list
+    if (!move_list->count)
+    {
+        printf("\n     No move in the move list!\n");
+        return;
+    }
+    
+    printf("\n     move    piece     capture   double    enpass    castling\n\n");
+    
+    // loop over moves within a move list
+    for (int move_count = 0; move_count < move_list->count; move_count++)
+    {
+        // init move
+        int move = move_list->moves[move_count].move;
+        
+        #ifdef WIN64
+            // print move
+            printf("      %s%s%c   %c         %d         %d         %d         %d\n", square_to_coordinates[get_move_source(move)],
+                                                                                  square_to_coordinates[get_move_target(move)],
                                                                                   get_move_promoted(move) ? promoted_pieces[get_move_promoted(move)] : ' ',
                                                                                   ascii_pieces[get_move_piece(move)],
                                                                                   get_move_capture(move) ? 1 : 0,
@@ -1008,17 +1613,18 @@ void print_move_list(moves *move_list)
 
 // preserve board state
 #define copy_board()                                                      \
-    U64 bitboards_copy[12], occupancies_copy[3];                          \
+    position_bitboards pos_copy;                                          \
+    uint8_t board_copy[64];                                               \
     int side_copy, enpassant_copy, castle_copy;                           \
-    memcpy(bitboards_copy, bitboards, 96);                                \
-    memcpy(occupancies_copy, occupancies, 24);                            \
+    memcpy(&pos_copy, &pos, 64);                                          \
+    memcpy(board_copy, board, 64);                                        \
     side_copy = side, enpassant_copy = enpassant, castle_copy = castle;   \
     U64 hash_key_copy = hash_key;                                         \
 
 // restore board state
 #define take_back()                                                       \
-    memcpy(bitboards, bitboards_copy, 96);                                \
-    memcpy(occupancies, occupancies_copy, 24);                            \
+    memcpy(&pos, &pos_copy, 64);                                          \
+    memcpy(board, board_copy, 64);                                        \
     side = side_copy, enpassant = enpassant_copy, castle = castle_copy;   \
     hash_key = hash_key_copy;                                             \
 
@@ -1054,303 +1660,405 @@ const int castling_rights[64] = {
 };
 
 
-// make move on chess board
-static inline int make_move(int move, int move_flag)
+/*
+    Side specialised make move & move generator
+
+    make_side_move() & generate_side_moves() take the side to move as a
+    constant parameter and are always inlined into their dispatchers,
+    so every side test folds away & each side gets its own branch free copy.
+*/
+
+// make move of the given side on chess board
+static inline __attribute__((always_inline)) int make_side_move(int move, const int us)
 {
-    // quiet moves
-    if (move_flag == all_moves)
+    // preserve board state
+    copy_board();
+    
+    // pawn push direction
+    const int pawn_step = (us == white) ? -8 : 8;
+    
+    // parse move
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+    int piece = get_move_piece(move);
+    int promoted_piece = get_move_promoted(move);
+    int captured_piece = piece_on(target_square);
+    int double_push = get_move_double(move);
+    int enpass = get_move_enpassant(move);
+    int castling = get_move_castling(move);
+    
+    // only king moves, enpassant captures, moves of pinned pieces or
+    // moves in check can expose the king
+    int verify_king = (piece == K + us * 6 || enpass || node_checkers() ||
+                      (node_pinned() & (1ULL << source_square)));
+    
+    // handling capture moves
+    if (captured_piece != no_piece)
     {
-        // preserve board state
-        copy_board();
+        // remove captured piece from the board
+        remove_piece(captured_piece, target_square);
         
-        // parse move
-        int source_square = get_move_source(move);
-        int target_square = get_move_target(move);
-        int piece = get_move_piece(move);
-        int promoted_piece = get_move_promoted(move);
-        int capture = get_move_capture(move);
-        int double_push = get_move_double(move);
-        int enpass = get_move_enpassant(move);
-        int castling = get_move_castling(move);
-        
-        // move piece
-        pop_bit(bitboards[piece], source_square);
-        set_bit(bitboards[piece], target_square);
-        
-        // hash piece
-        hash_key ^= piece_keys[piece][source_square]; // remove piece from source square in hash key
-        hash_key ^= piece_keys[piece][target_square]; // set piece to the target square in hash key
-        
-        // handling capture moves
-        if (capture)
-        {
-            // pick up bitboard piece index ranges depending on side
-            int start_piece, end_piece;
-            
-            // white to move
-            if (side == white)
-            {
-                start_piece = p;
-                end_piece = k;
-            }
-            
-            // black to move
-            else
-            {
-                start_piece = P;
-                end_piece = K;
-            }
-            
-            // loop over bitboards opposite to the current side to move
-            for (int bb_piece = start_piece; bb_piece <= end_piece; bb_piece++)
-            {
-                // if there's a piece on the target square
-                if (get_bit(bitboards[bb_piece], target_square))
-                {
-                    // remove it from corresponding bitboard
-                    pop_bit(bitboards[bb_piece], target_square);
-                    
-                    // remove the piece from hash key
-                    hash_key ^= piece_keys[bb_piece][target_square];
-                    break;
-                }
-            }
-        }
-        
-        // handle pawn promotions
-        if (promoted_piece)
-        {
-            // erase the pawn from the target square
-            //pop_bit(bitboards[(side == white) ? P : p], target_square);
-            
-            
-            // white to move
-            if (side == white)
-            {
-                // erase the pawn from the target square
-                pop_bit(bitboards[P], target_square);
-                
-                // remove pawn from hash key
-                hash_key ^= piece_keys[P][target_square];
-            }
-            
-            // black to move
-            else
-            {
-                // erase the pawn from the target square
-                pop_bit(bitboards[p], target_square);
-                
-                // remove pawn from hash key
-                hash_key ^= piece_keys[p][target_square];
-            }
-            
-            // set up promoted piece on chess board
-            set_bit(bitboards[promoted_piece], target_square);
-            
-            // add promoted piece into the hash key
-            hash_key ^= piece_keys[promoted_piece][target_square];
-        }
+        // remove the piece from hash key
+        hash_key ^= piece_keys[captured_piece][target_square];
+    }
+    
+    // move piece
+    move_piece(piece, source_square, target_square);
+    
+    // hash piece
+    hash_key ^= piece_keys[piece][source_square]; // remove piece from source square in hash key
+    hash_key ^= piece_keys[piece][target_square]; // set piece to the target square in hash key
+    
+    // handle pawn promotions
+    if (promoted_piece)
+    {
+        // erase the pawn from the target square
+        remove_piece(P + us * 6, target_square);
         
-        // handle enpassant captures
-        if (enpass)
-        {
-            // erase the pawn depending on side to move
-            (side == white) ? pop_bit(bitboards[p], target_square + 8) :
-                              pop_bit(bitboards[P], target_square - 8);
-                              
-            // white to move
-            if (side == white)
-            {
-                // remove captured pawn
-                pop_bit(bitboards[p], target_square + 8);
-                
-                // remove pawn from hash key
-                hash_key ^= piece_keys[p][target_square + 8];
-            }
-            
-            // black to move
-            else
-            {
-                // remove captured pawn
-                pop_bit(bitboards[P], target_square - 8);
-                
-                // remove pawn from hash key
-                hash_key ^= piece_keys[P][target_square - 8];
-            }
-        }
+        // remove pawn from hash key
+        hash_key ^= piece_keys[P + us * 6][target_square];
         
-        // hash enpassant if available (remove enpassant square from hash key )
-        if (enpassant != no_sq) hash_key ^= enpassant_keys[enpassant];
+        // set up promoted piece on chess board
+        put_piece(promoted_piece, target_square);
         
-        // reset enpassant square
-        enpassant = no_sq;
+        // add promoted piece into the hash key
+        hash_key ^= piece_keys[promoted_piece][target_square];
+    }
+    
+    // handle enpassant captures
+    if (enpass)
+    {
+        // remove captured pawn
+        remove_piece(P + (us ^ 1) * 6, target_square - pawn_step);
         
-        // handle double pawn push
-        if (double_push)
-        {
-            // set enpassant aquare depending on side to move
-            //(side == white) ? (enpassant = target_square + 8) :
-            //                  (enpassant = target_square - 8);
-                              
-            // white to move
-            if (side == white)
-            {
-                // set enpassant square
-                enpassant = target_square + 8;
-                
-                // hash enpassant
-                hash_key ^= enpassant_keys[target_square + 8];
-            }
-            
-            // black to move
-            else
-            {
-                // set enpassant square
-                enpassant = target_square - 8;
-                
-                // hash enpassant
-                hash_key ^= enpassant_keys[target_square - 8];
-            }
-        }
+        // remove pawn from hash key
+        hash_key ^= piece_keys[P + (us ^ 1) * 6][target_square - pawn_step];
+    }
+    
+    // hash enpassant if available (remove enpassant square from hash key )
+    if (enpassant != no_sq) hash_key ^= enpassant_keys[enpassant];
+    
+    // reset enpassant square
+    enpassant = no_sq;
+    
+    // handle double pawn push
+    if (double_push)
+    {
+        // set enpassant square
+        enpassant = target_square - pawn_step;
         
-        // handle castling moves
-        if (castling)
-        {
-            // switch target square
-            switch (target_square)
-            {
-                // white castles king side
-                case (g1):
-                    // move H rook
-                    pop_bit(bitboards[R], h1);
-                    set_bit(bitboards[R], f1);
-                    
-                    // hash rook
-                    hash_key ^= piece_keys[R][h1];  // remove rook from h1 from hash key
-                    hash_key ^= piece_keys[R][f1];  // put rook on f1 into a hash key
-                    break;
-                
-                // white castles queen side
-                case (c1):
-                    // move A rook
-                    pop_bit(bitboards[R], a1);
-                    set_bit(bitboards[R], d1);
-                    
-                    // hash rook
-                    hash_key ^= piece_keys[R][a1];  // remove rook from a1 from hash key
-                    hash_key ^= piece_keys[R][d1];  // put rook on d1 into a hash key
-                    break;
-                
-                // black castles king side
-                case (g8):
-                    // move H rook
-                    pop_bit(bitboards[r], h8);
-                    set_bit(bitboards[r], f8);
-                    
-                    // hash rook
-                    hash_key ^= piece_keys[r][h8];  // remove rook from h8 from hash key
-                    hash_key ^= piece_keys[r][f8];  // put rook on f8 into a hash key
-                    break;
-                
-                // black castles queen side
-                case (c8):
-                    // move A rook
-                    pop_bit(bitboards[r], a8);
-                    set_bit(bitboards[r], d8);
-                    
-                    // hash rook
-                    hash_key ^= piece_keys[r][a8];  // remove rook from a8 from hash key
-                    hash_key ^= piece_keys[r][d8];  // put rook on d8 into a hash key
-                    break;
-            }
-        }
+        // hash enpassant
+        hash_key ^= enpassant_keys[enpassant];
+    }
+    
+    // handle castling moves
+    if (castling)
+    {
+        // rook squares depending on castling side
+        int rook = R + us * 6;
+        int rook_source = ((target_square & 7) == 6) ? target_square + 1 : target_square - 2;
+        int rook_target = ((target_square & 7) == 6) ? target_square - 1 : target_square + 1;
         
-        // hash castling
-        hash_key ^= castle_keys[castle];
+        // move rook
+        move_piece(rook, rook_source, rook_target);
         
-        // update castling rights
-        castle &= castling_rights[source_square];
-        castle &= castling_rights[target_square];
+        // hash rook
+        hash_key ^= piece_keys[rook][rook_source];  // remove rook from its corner from hash key
+        hash_key ^= piece_keys[rook][rook_target];  // put rook next to the king into a hash key
+    }
+    
+    // hash castling
+    hash_key ^= castle_keys[castle];
+    
+    // update castling rights
+    castle &= castling_rights[source_square];
+    castle &= castling_rights[target_square];
 
-        // hash castling
-        hash_key ^= castle_keys[castle];
+    // hash castling
+    hash_key ^= castle_keys[castle];
+    
+    // change side
+    side = us ^ 1;
+    
+    // hash side
+    hash_key ^= side_key;
+    
+    //
+    // ====== debug hash key incremental update ======= //
+    //
+    
+    // build hash key for the updated position (after move is made) from scratch
+    /*U64 hash_from_scratch = generate_hash_key();
+    
+    // in case if hash key built from scratch doesn't match
+    // the one that was incrementally updated we interrupt execution
+    if (hash_key != hash_from_scratch)
+    {
+        printf("\n\nMake move\n");
+        printf("move: "); print_move(move);
+        print_board();
+        printf("hash key should be: %llx\n", hash_from_scratch);
+        getchar();
+    }*/
+    
+    // make sure that king has not been exposed into a check
+    if (verify_king && is_square_attacked(get_ls1b_index(pos.by_type[KING] & pos.by_color[us]), us ^ 1))
+    {
+        // take move back
+        take_back();
         
-        // reset occupancies
-        memset(occupancies, 0ULL, 24);
+        // return illegal move
+        return 0;
+    }
+    
+    // return legal move
+    return 1;
+}
+
+// make move on chess board
+static inline int make_move(int move, int move_flag)
+{
+    // quiet moves
+    if (move_flag == all_moves)
+        // dispatch to the side specialised version
+        return (side == white) ? make_side_move(move, white) : make_side_move(move, black);
+    
+    // capture moves
+    else
+    {
+        // make sure move is the capture
+        if (get_move_capture(move))
+            return make_move(move, all_moves);
         
-        // loop over white pieces bitboards
-        for (int bb_piece = P; bb_piece <= K; bb_piece++)
-            // update white occupancies
-            occupancies[white] |= bitboards[bb_piece];
+        // otherwise the move is not a capture
+        else
+            // don't make it
+            return 0;
+    }
+}
 
-        // loop over black pieces bitboards
-        for (int bb_piece = p; bb_piece <= k; bb_piece++)
-            // update black occupancies
-            occupancies[black] |= bitboards[bb_piece];
+// pass the turn (only side, enpassant & hash key change)
+static inline void make_null_move()
+{
+    // hash enpassant if available
+    if (enpassant != no_sq)
+        hash_key ^= enpassant_keys[enpassant];
+    
+    // reset enpassant capture square
+    enpassant = no_sq;
+    
+    // change side & hash it
+    side ^= 1;
+    hash_key ^= side_key;
+}
 
-        // update both sides occupancies
-        occupancies[both] |= occupancies[white];
-        occupancies[both] |= occupancies[black];
-        
-        // change side
-        side ^= 1;
+// take the null move back (enpassant square before the null move)
+static inline void unmake_null_move(int old_enpassant)
+{
+    // change side back & hash it
+    side ^= 1;
+    hash_key ^= side_key;
+    
+    // restore enpassant square & hash it
+    enpassant = old_enpassant;
+    
+    if (enpassant != no_sq)
+        hash_key ^= enpassant_keys[enpassant];
+}
+
+// add pawn move (all four promotions from the last rank but one)
+static inline void add_pawn_move(moves *move_list, int source_square, int target_square, const int us)
+{
+    // pawn promotion
+    if ((us == white) ? (source_square >= a7 && source_square <= h7) : (source_square >= a2 && source_square <= h2))
+    {
+        add_move(move_list, encode_move(source_square, target_square, Q + us * 6));
+        add_move(move_list, encode_move(source_square, target_square, R + us * 6));
+        add_move(move_list, encode_move(source_square, target_square, B + us * 6));
+        add_move(move_list, encode_move(source_square, target_square, N + us * 6));
+    }
+    
+    else
+        add_move(move_list, encode_move(source_square, target_square, 0));
+}
+
+// add moves from the source square to every target square
+static inline void add_piece_moves(moves *move_list, int source_square, U64 attacks)
+{
+    // loop over target squares available from generated attacks
+    while (attacks)
+    {
+        // init target square
+        int target_square = get_ls1b_index(attacks);
         
-        // hash side
-        hash_key ^= side_key;
+        // quiet move or capture
+        add_move(move_list, encode_move(source_square, target_square, 0));
         
-        //
-        // ====== debug hash key incremental update ======= //
-        //
+        // pop ls1b in current attacks set
+        pop_bit(attacks, target_square);
+    }
+}
+
+// generate all moves of the given side
+static inline __attribute__((always_inline)) void generate_side_moves(moves *move_list, const int us)
+{
+    // init move count
+    move_list->count = 0;
+
+    // define source & target squares
+    int source_square, target_square;
+    
+    // define current piece's bitboard copy & it's attacks
+    U64 bitboard, attacks;
+    
+    // pawn push direction
+    const int pawn_step = (us == white) ? -8 : 8;
+    
+    // own & enemy pieces
+    U64 own = pos.by_color[us], enemy = pos.by_color[us ^ 1];
+    
+    // loop over pawns
+    bitboard = pos.by_type[PAWN] & own;
+    
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
         
-        // build hash key for the updated position (after move is made) from scratch
-        /*U64 hash_from_scratch = generate_hash_key();
+        // init target square
+        target_square = source_square + pawn_step;
         
-        // in case if hash key built from scratch doesn't match
-        // the one that was incrementally updated we interrupt execution
-        if (hash_key != hash_from_scratch)
+        // generate quiet pawn moves
+        if (!get_bit(occupied(), target_square))
         {
-            printf("\n\nMake move\n");
-            printf("move: "); print_move(move);
-            print_board();
-            printf("hash key should be: %llx\n", hash_from_scratch);
-            getchar();
-        }*/
+            // one square ahead pawn move (with promotions)
+            add_pawn_move(move_list, source_square, target_square, us);
+            
+            // two squares ahead pawn move
+            if (((us == white) ? (source_square >= a2 && source_square <= h2) : (source_square >= a7 && source_square <= h7)) &&
+                !get_bit(occupied(), target_square + pawn_step))
+                add_move(move_list, encode_move(source_square, target_square + pawn_step, MOVE_DOUBLE));
+        }
         
+        // init pawn attacks bitboard
+        attacks = pawn_attacks[us][source_square] & enemy;
         
-        // make sure that king has not been exposed into a check
-        if (is_square_attacked((side == white) ? get_ls1b_index(bitboards[k]) : get_ls1b_index(bitboards[K]), side))
+        // generate pawn captures
+        while (attacks)
         {
-            // take move back
-            take_back();
+            // init target square
+            target_square = get_ls1b_index(attacks);
             
-            // return illegal move
-            return 0;
+            // pawn capture (with promotions)
+            add_pawn_move(move_list, source_square, target_square, us);
+            
+            // pop ls1b of the pawn attacks
+            pop_bit(attacks, target_square);
         }
         
-        //
-        else
-            // return legal move
-            return 1;
-            
-            
+        // generate enpassant captures
+        if (enpassant != no_sq && (pawn_attacks[us][source_square] & (1ULL << enpassant)))
+            add_move(move_list, encode_move(source_square, enpassant, MOVE_ENPASSANT));
+        
+        // pop ls1b from piece bitboard copy
+        pop_bit(bitboard, source_square);
     }
     
-    // capture moves
-    else
+    // genarate knight moves
+    bitboard = pos.by_type[KNIGHT] & own;
+    
+    while (bitboard)
     {
-        // make sure move is the capture
-        if (get_move_capture(move))
-            make_move(move, all_moves);
-        
-        // otherwise the move is not a capture
-        else
-            // don't make it
-            return 0;
+        source_square = get_ls1b_index(bitboard);
+        add_piece_moves(move_list, source_square, knight_attacks[source_square] & ~own);
+        pop_bit(bitboard, source_square);
+    }
+    
+    // generate bishop moves
+    bitboard = pos.by_type[BISHOP] & own;
+    
+    while (bitboard)
+    {
+        source_square = get_ls1b_index(bitboard);
+        add_piece_moves(move_list, source_square, get_bishop_attacks(source_square, occupied()) & ~own);
+        pop_bit(bitboard, source_square);
+    }
+    
+    // generate rook moves
+    bitboard = pos.by_type[ROOK] & own;
+    
+    while (bitboard)
+    {
+        source_square = get_ls1b_index(bitboard);
+        add_piece_moves(move_list, source_square, get_rook_attacks(source_square, occupied()) & ~own);
+        pop_bit(bitboard, source_square);
+    }
+    
+    // generate queen moves
+    bitboard = pos.by_type[QUEEN] & own;
+    
+    while (bitboard)
+    {
+        source_square = get_ls1b_index(bitboard);
+        add_piece_moves(move_list, source_square, get_queen_attacks(source_square, occupied()) & ~own);
+        pop_bit(bitboard, source_square);
     }
+    
+    // castling squares of the side to move
+    const int king_square = (us == white) ? e1 : e8;
+    const int king_side = (us == white) ? wk : bk;
+    const int queen_side = (us == white) ? wq : bq;
+    
+    // king side castling is available
+    if (castle & king_side)
+    {
+        // make sure square between king and king's rook are empty
+        if (!(occupied() & ((1ULL << (king_square + 1)) | (1ULL << (king_square + 2)))))
+        {
+            // make sure king and the f-file squares are not under attacks
+            if (!(node_side_attacks(us ^ 1) & ((1ULL << king_square) | (1ULL << (king_square + 1)))))
+                add_move(move_list, encode_move(king_square, king_square + 2, MOVE_CASTLING));
+        }
+    }
+    
+    // queen side castling is available
+    if (castle & queen_side)
+    {
+        // make sure square between king and queen's rook are empty
+        if (!(occupied() & ((1ULL << (king_square - 1)) | (1ULL << (king_square - 2)) | (1ULL << (king_square - 3)))))
+        {
+            // make sure king and the d-file squares are not under attacks
+            if (!(node_side_attacks(us ^ 1) & ((1ULL << king_square) | (1ULL << (king_square - 1)))))
+                add_move(move_list, encode_move(king_square, king_square - 2, MOVE_CASTLING));
+        }
+    }
+    
+    // generate king moves
+    source_square = get_ls1b_index(pos.by_type[KING] & own);
+    add_piece_moves(move_list, source_square, king_attacks[source_square] & ~own);
 }
 
 // generate all moves
 static inline void generate_moves(moves *move_list)
+{
+    // dispatch to the side specialised version
+    if (side == white)
+        generate_side_moves(move_list, white);
+    else
+        generate_side_moves(move_list, black);
+}
+
+/*
+    Check evasions
+
+    In check only king moves, captures of the checking piece and
+    interpositions on the check ray can be legal (on double check only
+    king moves are). Pinned blockers & king steps along the check ray
+    are still rejected by make_move.
+*/
+
+// generate check evasions
+static inline void generate_evasions(moves *move_list)
 {
     // init move count
     move_list->count = 0;
@@ -1361,420 +2069,195 @@ static inline void generate_moves(moves *move_list)
     // define current piece's bitboard copy & it's attacks
     U64 bitboard, attacks;
     
-    // loop over all the bitboards
-    for (int piece = P; piece <= k; piece++)
+    // init king & checkers
+    int king = K + side * 6;
+    int king_square = get_ls1b_index(pieces(king));
+    U64 checkers = node_checkers();
+    
+    // king moves to squares not attacked by the enemy
+    attacks = king_attacks[king_square] & ~pos.by_color[side] & ~node_side_attacks(side ^ 1);
+    
+    while (attacks)
     {
-        // init piece bitboard copy
-        bitboard = bitboards[piece];
+        target_square = get_ls1b_index(attacks);
         
-        // generate white pawns & white king castling moves
-        if (side == white)
-        {
-            // pick up white pawn bitboards index
-            if (piece == P)
-            {
-                // loop over white pawns within white pawn bitboard
-                while (bitboard)
-                {
-                    // init source square
-                    source_square = get_ls1b_index(bitboard);
-                    
-                    // init target square
-                    target_square = source_square - 8;
-                    
-                    // generate quiet pawn moves
-                    if (!(target_square < a8) && !get_bit(occupancies[both], target_square))
-                    {
-                        // pawn promotion
-                        if (source_square >= a7 && source_square <= h7)
-                        {                            
-                            add_move(move_list, encode_move(source_square, target_square, piece, Q, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, R, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, B, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, N, 0, 0, 0, 0));
-                        }
-                        
-                        else
-                        {
-                            // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-                            
-                            // two squares ahead pawn move
-                            if ((source_square >= a2 && source_square <= h2) && !get_bit(occupancies[both], target_square - 8))
-                                add_move(move_list, encode_move(source_square, target_square - 8, piece, 0, 0, 1, 0, 0));
-                        }
-                    }
-                    
-                    // init pawn attacks bitboard
-                    attacks = pawn_attacks[side][source_square] & occupancies[black];
-                    
-                    // generate pawn captures
-                    while (attacks)
-                    {
-                        // init target square
-                        target_square = get_ls1b_index(attacks);
-                        
-                        // pawn promotion
-                        if (source_square >= a7 && source_square <= h7)
-                        {
-                            add_move(move_list, encode_move(source_square, target_square, piece, Q, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, R, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, B, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, N, 1, 0, 0, 0));
-                        }
-                        
-                        else
-                            // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-                        
-                        // pop ls1b of the pawn attacks
-                        pop_bit(attacks, target_square);
-                    }
-                    
-                    // generate enpassant captures
-                    if (enpassant != no_sq)
-                    {
-                        // lookup pawn attacks and bitwise AND with enpassant square (bit)
-                        U64 enpassant_attacks = pawn_attacks[side][source_square] & (1ULL << enpassant);
-                        
-                        // make sure enpassant capture available
-                        if (enpassant_attacks)
-                        {
-                            // init enpassant capture target square
-                            int target_enpassant = get_ls1b_index(enpassant_attacks);
-                            add_move(move_list, encode_move(source_square, target_enpassant, piece, 0, 1, 0, 1, 0));
-                        }
-                    }
-                    
-                    // pop ls1b from piece bitboard copy
-                    pop_bit(bitboard, source_square);
-                }
-            }
-            
-            // castling moves
-            if (piece == K)
-            {
-                // king side castling is available
-                if (castle & wk)
-                {
-                    // make sure square between king and king's rook are empty
-                    if (!get_bit(occupancies[both], f1) && !get_bit(occupancies[both], g1))
-                    {
-                        // make sure king and the f1 squares are not under attacks
-                        if (!is_square_attacked(e1, black) && !is_square_attacked(f1, black))
-                            add_move(move_list, encode_move(e1, g1, piece, 0, 0, 0, 0, 1));
-                    }
-                }
-                
-                // queen side castling is available
-                if (castle & wq)
-                {
-                    // make sure square between king and queen's rook are empty
-                    if (!get_bit(occupancies[both], d1) && !get_bit(occupancies[both], c1) && !get_bit(occupancies[both], b1))
-                    {
-                        // make sure king and the d1 squares are not under attacks
-                        if (!is_square_attacked(e1, black) && !is_square_attacked(d1, black))
-                            add_move(move_list, encode_move(e1, c1, piece, 0, 0, 0, 0, 1));
-                    }
-                }
-            }
-        }
+        add_move(move_list, encode_move(king_square, target_square, 0));
         
-        // generate black pawns & black king castling moves
-        else
+        pop_bit(attacks, target_square);
+    }
+    
+    // double check, only king moves are possible
+    if (checkers & (checkers - 1))
+        return;
+    
+    // squares capturing the checker or blocking the check
+    U64 target_mask = checkers | between_squares[king_square][get_ls1b_index(checkers)];
+    
+    // pawn move direction
+    int pawn = P + side * 6;
+    int direction = (side == white) ? -8 : 8;
+    
+    // loop over pawns
+    bitboard = pieces(pawn);
+    
+    while (bitboard)
+    {
+        // init source & target squares
+        source_square = get_ls1b_index(bitboard);
+        target_square = source_square + direction;
+        
+        // pushes blocking the check
+        if (!get_bit(occupied(), target_square))
         {
-            // pick up black pawn bitboards index
-            if (piece == p)
-            {
-                // loop over white pawns within white pawn bitboard
-                while (bitboard)
-                {
-                    // init source square
-                    source_square = get_ls1b_index(bitboard);
-                    
-                    // init target square
-                    target_square = source_square + 8;
-                    
-                    // generate quiet pawn moves
-                    if (!(target_square > h1) && !get_bit(occupancies[both], target_square))
-                    {
-                        // pawn promotion
-                        if (source_square >= a2 && source_square <= h2)
-                        {
-                            add_move(move_list, encode_move(source_square, target_square, piece, q, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, r, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, b, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, n, 0, 0, 0, 0));
-                        }
-                        
-                        else
-                        {
-                            // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-                            
-                            // two squares ahead pawn move
-                            if ((source_square >= a7 && source_square <= h7) && !get_bit(occupancies[both], target_square + 8))
-                                add_move(move_list, encode_move(source_square, target_square + 8, piece, 0, 0, 1, 0, 0));
-                        }
-                    }
-                    
-                    // init pawn attacks bitboard
-                    attacks = pawn_attacks[side][source_square] & occupancies[white];
-                    
-                    // generate pawn captures
-                    while (attacks)
-                    {
-                        // init target square
-                        target_square = get_ls1b_index(attacks);
-                        
-                        // pawn promotion
-                        if (source_square >= a2 && source_square <= h2)
-                        {
-                            add_move(move_list, encode_move(source_square, target_square, piece, q, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, r, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, b, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, n, 1, 0, 0, 0));
-                        }
-                        
-                        else
-                            // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-                        
-                        // pop ls1b of the pawn attacks
-                        pop_bit(attacks, target_square);
-                    }
-                    
-                    // generate enpassant captures
-                    if (enpassant != no_sq)
-                    {
-                        // lookup pawn attacks and bitwise AND with enpassant square (bit)
-                        U64 enpassant_attacks = pawn_attacks[side][source_square] & (1ULL << enpassant);
-                        
-                        // make sure enpassant capture available
-                        if (enpassant_attacks)
-                        {
-                            // init enpassant capture target square
-                            int target_enpassant = get_ls1b_index(enpassant_attacks);
-                            add_move(move_list, encode_move(source_square, target_enpassant, piece, 0, 1, 0, 1, 0));
-                        }
-                    }
-                    
-                    // pop ls1b from piece bitboard copy
-                    pop_bit(bitboard, source_square);
-                }
-            }
+            // one square ahead pawn move
+            if (get_bit(target_mask, target_square))
+                add_pawn_move(move_list, source_square, target_square, side);
             
-            // castling moves
-            if (piece == k)
-            {
-                // king side castling is available
-                if (castle & bk)
-                {
-                    // make sure square between king and king's rook are empty
-                    if (!get_bit(occupancies[both], f8) && !get_bit(occupancies[both], g8))
-                    {
-                        // make sure king and the f8 squares are not under attacks
-                        if (!is_square_attacked(e8, white) && !is_square_attacked(f8, white))
-                            add_move(move_list, encode_move(e8, g8, piece, 0, 0, 0, 0, 1));
-                    }
-                }
-                
-                // queen side castling is available
-                if (castle & bq)
-                {
-                    // make sure square between king and queen's rook are empty
-                    if (!get_bit(occupancies[both], d8) && !get_bit(occupancies[both], c8) && !get_bit(occupancies[both], b8))
-                    {
-                        // make sure king and the d8 squares are not under attacks
-                        if (!is_square_attacked(e8, white) && !is_square_attacked(d8, white))
-                            add_move(move_list, encode_move(e8, c8, piece, 0, 0, 0, 0, 1));
-                    }
-                }
-            }
+            // two squares ahead pawn move
+            else if (((side == white) ? (source_square >= a2 && source_square <= h2) : (source_square >= a7 && source_square <= h7)) &&
+                     get_bit(target_mask, target_square + direction) &&
+                     !get_bit(occupied(), target_square + direction))
+                add_move(move_list, encode_move(source_square, target_square + direction, MOVE_DOUBLE));
         }
         
-        // genarate knight moves
-        if ((side == white) ? piece == N : piece == n)
-        {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
-            {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
-                
-                // init piece attacks in order to get set of target squares
-                attacks = knight_attacks[source_square] & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
-                
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);    
-                    
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-                    
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-                    
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
-                
-                
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
-            }
-        }
+        // captures of the checker
+        if (pawn_attacks[side][source_square] & checkers)
+            add_pawn_move(move_list, source_square, get_ls1b_index(checkers), side);
         
-        // generate bishop moves
-        if ((side == white) ? piece == B : piece == b)
+        // enpassant capturing the checker or blocking the check
+        if (enpassant != no_sq && (pawn_attacks[side][source_square] & (1ULL << enpassant)))
         {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
-            {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
-                
-                // init piece attacks in order to get set of target squares
-                attacks = get_bishop_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
-                
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);    
-                    
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-                    
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-                    
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
-                
-                
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
-            }
+            if (get_bit(checkers, enpassant - direction) || get_bit(target_mask, enpassant))
+                add_move(move_list, encode_move(source_square, enpassant, MOVE_ENPASSANT));
         }
         
-        // generate rook moves
-        if ((side == white) ? piece == R : piece == r)
+        // pop ls1b from piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
+    
+    // loop over knights, bishops, rooks & queens
+    for (int piece = N + side * 6; piece <= Q + side * 6; piece++)
+    {
+        bitboard = pieces(piece);
+        
+        while (bitboard)
         {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
+            // init source square
+            source_square = get_ls1b_index(bitboard);
+            
+            // init piece attacks landing on the target mask
+            switch (PieceToPieceType[piece])
             {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
-                
-                // init piece attacks in order to get set of target squares
-                attacks = get_rook_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
-                
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);    
-                    
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-                    
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-                    
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
-                
-                
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
+                case KNIGHT: attacks = knight_attacks[source_square]; break;
+                case BISHOP: attacks = get_bishop_attacks(source_square, occupied()); break;
+                case ROOK: attacks = get_rook_attacks(source_square, occupied()); break;
+                default: attacks = get_queen_attacks(source_square, occupied()); break;
             }
-        }
-        
-        // generate queen moves
-        if ((side == white) ? piece == Q : piece == q)
-        {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
+            
+            attacks &= target_mask;
+            
+            // loop over target squares
+            while (attacks)
             {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
-                
-                // init piece attacks in order to get set of target squares
-                attacks = get_queen_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
-                
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);    
-                    
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-                    
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-                    
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
+                target_square = get_ls1b_index(attacks);
                 
+                add_move(move_list, encode_move(source_square, target_square, 0));
                 
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
+                pop_bit(attacks, target_square);
             }
+            
+            // pop ls1b of the current piece bitboard copy
+            pop_bit(bitboard, source_square);
         }
+    }
+}
 
-        // generate king moves
-        if ((side == white) ? piece == K : piece == k)
-        {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
-            {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
-                
-                // init piece attacks in order to get set of target squares
-                attacks = king_attacks[source_square] & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
-                
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);    
-                    
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-                    
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-                    
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
+/*
+    Pseudo legality
 
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
-            }
+    Moves coming from the transposition table or the killer slots were
+    generated in some other position. A move is accepted when the move
+    generator would produce it here, so it can be played before (or
+    instead of) generating the move list. Leaving the own king in check
+    is caught by make_move as for generated moves.
+*/
+
+// would the move generator produce the move in the current position
+static inline int is_pseudo_legal(int move)
+{
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+    int flag = get_move_flag(move);
+    int piece = piece_on(source_square);
+    U64 target = 1ULL << target_square;
+    
+    // no move or no own piece on source square
+    if (!move || piece == no_piece || get_piece_color(piece) != side)
+        return 0;
+    
+    // own piece on target square
+    if (pos.by_color[side] & target)
+        return 0;
+    
+    // castling as in the move generator
+    if (flag == MOVE_CASTLING)
+    {
+        int king_square = (side == white) ? e1 : e8;
+        int king_side = (target_square == king_square + 2);
+        int right = (side == white) ? (king_side ? wk : wq) : (king_side ? bk : bq);
+        U64 empty = king_side ? (3ULL << (king_square + 1)) : (7ULL << (king_square - 3));
+        U64 safe = king_side ? (3ULL << king_square) : (3ULL << (king_square - 1));
+        
+        return piece == K + side * 6 && source_square == king_square &&
+               (target_square == king_square + 2 || target_square == king_square - 2) &&
+               (castle & right) && !(occupied() & empty) && !(node_side_attacks(side ^ 1) & safe);
+    }
+    
+    // piece moves
+    if (get_piece_type(piece) != PAWN)
+    {
+        // only pawns have special flags
+        if (flag)
+            return 0;
+        
+        switch (get_piece_type(piece))
+        {
+            case KNIGHT: return (knight_attacks[source_square] & target) != 0;
+            case BISHOP: return (get_bishop_attacks(source_square, occupied()) & target) != 0;
+            case ROOK: return (get_rook_attacks(source_square, occupied()) & target) != 0;
+            case QUEEN: return (get_queen_attacks(source_square, occupied()) & target) != 0;
+            default: return (king_attacks[source_square] & target) != 0;
         }
     }
+    
+    // pawn push direction & promotion rank
+    int pawn_step = (side == white) ? -8 : 8;
+    int promotion = (side == white) ? (target_square <= h8) : (target_square >= a1);
+    
+    // enpassant capture onto the enpassant square
+    if (flag == MOVE_ENPASSANT)
+        return target_square == enpassant && (pawn_attacks[side][source_square] & target);
+    
+    // double push from the start rank over an empty square
+    if (flag == MOVE_DOUBLE)
+        return ((side == white) ? (source_square >= a2 && source_square <= h2) : (source_square >= a7 && source_square <= h7)) &&
+               target_square == source_square + 2 * pawn_step &&
+               !(occupied() & ((1ULL << (source_square + pawn_step)) | target));
+    
+    // moves onto the last rank have to promote to an own piece
+    if (promotion != (flag != 0))
+        return 0;
+    
+    if (flag && (get_piece_color(flag) != side || get_piece_type(flag) == PAWN || get_piece_type(flag) == KING))
+        return 0;
+    
+    // single push onto an empty square or capture of an enemy piece
+    if (target_square == source_square + pawn_step)
+        return !(occupied() & target);
+    
+    return (pawn_attacks[side][source_square] & pos.by_color[side ^ 1] & target) != 0;
 }
 
-
 /**********************************\
  ==================================
  
@@ -1800,8 +2283,11 @@ static inline void perft_driver(int depth)
     // create move list instance
     moves move_list[1];
     
-    // generate moves
-    generate_moves(move_list);
+    // generate evasions in check, all moves otherwise
+    if (node_checkers())
+        generate_evasions(move_list);
+    else
+        generate_moves(move_list);
     
         // loop over generated moves
     for (int move_count = 0; move_count < move_list->count; move_count++)
@@ -1810,12 +2296,14 @@ static inline void perft_driver(int depth)
         copy_board();
         
         // make move
-        if (!make_move(move_list->moves[move_count], all_moves))
+        if (!make_move(move_list->moves[move_count].move, all_moves))
             // skip to the next move
             continue;
         
-        // call perft driver recursively
+        // call perft driver recursively (own ply keeps attack cache of this node)
+        ply++;
         perft_driver(depth - 1);
+        ply--;
         
         // take back
         take_back();
@@ -1829,7 +2317,7 @@ static inline void perft_driver(int depth)
         if (hash_key != hash_from_scratch)
         {
             printf("\n\nTake back\n");
-            printf("move: "); print_move(move_list->moves[move_count]);
+            printf("move: "); print_move(move_list->moves[move_count].move);
             print_board();
             printf("hash key should be: %llx\n", hash_from_scratch);
             getchar();
@@ -1858,7 +2346,7 @@ void perft_test(int depth)
         copy_board();
         
         // make move
-        if (!make_move(move_list->moves[move_count], all_moves))
+        if (!make_move(move_list->moves[move_count].move, all_moves))
             // skip to the next move
             continue;
         
@@ -1866,7 +2354,9 @@ void perft_test(int depth)
         long cummulative_nodes = nodes;
         
         // call perft driver recursively
+        ply++;
         perft_driver(depth - 1);
+        ply--;
         
         // old nodes
         long old_nodes = nodes - cummulative_nodes;
@@ -1875,9 +2365,9 @@ void perft_test(int depth)
         take_back();
         
         // print move
-        printf("     move: %s%s%c  nodes: %ld\n", square_to_coordinates[get_move_source(move_list->moves[move_count])],
-                                                 square_to_coordinates[get_move_target(move_list->moves[move_count])],
-                                                 get_move_promoted(move_list->moves[move_count]) ? promoted_pieces[get_move_promoted(move_list->moves[move_count])] : ' ',
+        printf("     move: %s%s%c  nodes: %ld\n", square_to_coordinates[get_move_source(move_list->moves[move_count].move)],
+                                                 square_to_coordinates[get_move_target(move_list->moves[move_count].move)],
+                                                 get_move_promoted(move_list->moves[move_count].move) ? promoted_pieces[get_move_promoted(move_list->moves[move_count].move)] : ' ',
                                                  old_nodes);
     }
     
@@ -2063,32 +2553,31 @@ const int get_rank[64] =
 };
 
 
-// double pawns penalty
-const int double_pawn_penalty_opening = -5;
-const int double_pawn_penalty_endgame = -10;
+// double pawns penalty (per pawn behind a friendly one)
+const int double_pawn_penalty = S(-20, -40);
 
 // isolated pawn penalty
-const int isolated_pawn_penalty_opening = -5;
-const int isolated_pawn_penalty_endgame = -10;
+const int isolated_pawn_penalty = S(-5, -10);
 
 // passed pawn bonus
-const int passed_pawn_bonus[8] = { 0, 10, 30, 50, 75, 100, 150, 200 }; 
+const int passed_pawn_bonus[8] = { S(0, 0), S(10, 10), S(30, 30), S(50, 50), S(75, 75), S(100, 100), S(150, 150), S(200, 200) };
 
 // semi open file score
-const int semi_open_file_score = 10;
+const int semi_open_file_score = S(10, 10);
 
 // open file score
-const int open_file_score = 15;
+const int open_file_score = S(15, 15);
+
+// king shield bonus
+const int king_shield_bonus = S(5, 5);
 
 // mobility units (values from engine Fruit reloaded)
 static const int bishop_unit = 4;
 static const int queen_unit = 9;
 
 // mobility bonuses (values from engine Fruit reloaded)
-static const int bishop_mobility_opening = 5;
-static const int bishop_mobility_endgame = 5;
-static const int queen_mobility_opening = 1;
-static const int queen_mobility_endgame = 2;
+static const int bishop_mobility = S(5, 5);
+static const int queen_mobility = S(1, 2);
 
 int mg_value[6] = { 82, 337, 365, 477, 1025,  0};
 int eg_value[6] = { 94, 281, 297, 512,  936,  0};
@@ -2248,10 +2737,14 @@ int* eg_pesto_table[6] =
     eg_king_table
 };
 
-int gamephaseInc[12] = {0,0,1,1,1,1,2,2,4,4,0,0};
 int mg_table[12][64];
 int eg_table[12][64];
 
+// 16-bit PSQT lanes for the vectorised kernels (black entries are negated,
+// so a single accumulator sums white - black)
+int16_t mg_table16[12][64] __attribute__((aligned(64)));
+int16_t eg_table16[12][64] __attribute__((aligned(64)));
+
 void init_tables()
 {
     for (int pc = P;pc < p; pc++){
@@ -2263,450 +2756,526 @@ void init_tables()
             eg_table[pc+6][sq] = eg_value[p] + eg_pesto_table[p][mirror_score[sq]];
         }
     }
+
+    for (int pc = P; pc <= k; pc++){
+        for (int sq = 0; sq < 64; sq++) {
+            mg_table16[pc][sq] = (pc < p) ? mg_table[pc][sq] : -mg_table[pc][sq];
+            eg_table16[pc][sq] = (pc < p) ? eg_table[pc][sq] : -eg_table[pc][sq];
+        }
+    }
 }
 
-static inline int pesto_evaluate()
-{
-    int mg[2];
-    int eg[2];
-    int gamePhase = 0;
+/*
+    PSQT kernels
 
-    mg[white] = 0;
-    mg[black] = 0;
-    eg[white] = 0;
-    eg[black] = 0;
-    
-    U64 bitboard;
-    
-    // init piece & square
-    int piece, square;
-    
-    // penalties
-    int double_pawns = 0;
+    Every kernel returns the white - black sum of mg_table/eg_table over
+    all pieces on the board. The SIMD variants expand each piece bitboard
+    into per-square lane masks and accumulate the masked table rows, so no
+    bit serialization is needed. A lane never collects more than 8 squares,
+    hence 16-bit accumulators can't overflow.
+*/
+
+// PSQT kernel signature
+typedef void (*psqt_kernel)(int *mg, int *eg);
+
+// scalar reference kernel
+static void psqt_scalar(int *mg, int *eg)
+{
+    *mg = 0;
+    *eg = 0;
 
-    for (int bb_piece = P; bb_piece <= k; bb_piece++)
+    for (int piece = P; piece <= k; piece++)
     {
-        // init piece bitboard copy
-        bitboard = bitboards[bb_piece];
-        
-        
-        // loop over pieces within a bitboard
+        U64 bitboard = pieces(piece);
+
         while (bitboard)
         {
-            // init piece
-            piece = bb_piece;
-            
-            // init square
-            square = get_ls1b_index(bitboard);
+            int square = get_ls1b_index(bitboard);
 
-            switch (piece)
-            {
-                case P:
+            *mg += mg_table16[piece][square];
+            *eg += eg_table16[piece][square];
 
-                    mg[white] += mg_table[bb_piece][square];
-                    eg[white] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
+            pop_bit(bitboard, square);
+        }
+    }
+}
 
-                    double_pawns = count_bits(bitboards[P] & file_masks[square]);
+#ifdef USE_X86_SIMD
 
-                    if (double_pawns > 1){
-                        mg[white] += double_pawns * double_pawn_penalty_opening;
-                        eg[white] += double_pawns * double_pawn_penalty_endgame;
-                    }
-                    if ((bitboards[P] & isolated_masks[square]) == 0){
-                        mg[white] += isolated_pawn_penalty_opening;
-                        eg[white] += isolated_pawn_penalty_endgame;
-                    }
-                    if ((white_passed_masks[square] & bitboards[p]) == 0){
-                        mg[white] += passed_pawn_bonus[get_rank[square]];
-                        eg[white] += passed_pawn_bonus[get_rank[square]];
-                    }
+// SSE2 kernel: 8 squares (one rank) per step
+__attribute__((target("sse2")))
+static void psqt_sse2(int *mg, int *eg)
+{
+    const __m128i bits = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m128i ones = _mm_set1_epi16(1);
 
-                    break;
+    __m128i mg_sum = _mm_setzero_si128();
+    __m128i eg_sum = _mm_setzero_si128();
 
-                case N: 
-                    mg[white] += mg_table[bb_piece][square];
-                    eg[white] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece]; break;
-                case B: 
-                    mg[white] += mg_table[bb_piece][square];
-                    eg[white] += eg_table[bb_piece][square]; 
-                    gamePhase += gamephaseInc[bb_piece];
-
-                    mg[white] += (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_opening;
-                    eg[white] += (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_endgame;
-                    
-                    break;
-                
-                case R:
+    for (int piece = P; piece <= k; piece++)
+    {
+        U64 bitboard = pieces(piece);
 
-                    mg[white] += mg_table[bb_piece][square];
-                    eg[white] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
-                    
-                    if ((bitboards[P] & file_masks[square]) == 0){
-                        // add semi open file bonus
-                        mg[white] += semi_open_file_score;
-                        eg[white] += semi_open_file_score;
-                    }
-                    
-                    if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0){
-                        mg[white] += open_file_score;
-                        eg[white] += open_file_score;
-                    }
-                    
-                    break;
-                
-                case Q:
-                    mg[white] += mg_table[bb_piece][square];
-                    eg[white] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
+        if (!bitboard) continue;
 
-                    mg[white] += (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_opening;
-                    eg[white] += (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_endgame;
-                    break;
-                case K:
-                    mg[white] += mg_table[bb_piece][square];
-                    eg[white] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
-                    
+        for (int chunk = 0; chunk < 8; chunk++)
+        {
+            // expand 8 bits into 8 lane masks
+            __m128i mask = _mm_set1_epi16((short)((bitboard >> (chunk * 8)) & 0xff));
+            mask = _mm_cmpeq_epi16(_mm_and_si128(mask, bits), bits);
 
-                    if ((bitboards[P] & file_masks[square]) == 0){
-                        mg[white] -= semi_open_file_score;
-                        eg[white] -= semi_open_file_score;
-                    }
-                    
-                    if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0){
-                        mg[white] -= open_file_score;
-                        eg[white] -= open_file_score;
-                    }
+            mg_sum = _mm_add_epi16(mg_sum, _mm_and_si128(mask, _mm_load_si128((__m128i *)&mg_table16[piece][chunk * 8])));
+            eg_sum = _mm_add_epi16(eg_sum, _mm_and_si128(mask, _mm_load_si128((__m128i *)&eg_table16[piece][chunk * 8])));
+        }
+    }
 
-                    mg[white] += count_bits(king_attacks[square] & occupancies[white]) * 5;
-                    eg[white] += count_bits(king_attacks[square] & occupancies[white]) * 5;
+    // widen to 32 bits & reduce
+    mg_sum = _mm_madd_epi16(mg_sum, ones);
+    eg_sum = _mm_madd_epi16(eg_sum, ones);
+    mg_sum = _mm_add_epi32(mg_sum, _mm_shuffle_epi32(mg_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    eg_sum = _mm_add_epi32(eg_sum, _mm_shuffle_epi32(eg_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    mg_sum = _mm_add_epi32(mg_sum, _mm_shuffle_epi32(mg_sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    eg_sum = _mm_add_epi32(eg_sum, _mm_shuffle_epi32(eg_sum, _MM_SHUFFLE(2, 3, 0, 1)));
 
-                    break;
+    *mg = _mm_cvtsi128_si32(mg_sum);
+    *eg = _mm_cvtsi128_si32(eg_sum);
+}
 
-                case p:
-                    mg[black] += mg_table[bb_piece][square];
-                    eg[black] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
+// AVX2 kernel: 16 squares (two ranks) per step
+__attribute__((target("avx2")))
+static void psqt_avx2(int *mg, int *eg)
+{
+    const __m256i bits = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128,
+                                           256, 512, 1024, 2048, 4096, 8192, 16384, (short)0x8000);
+    const __m256i ones = _mm256_set1_epi16(1);
 
-                    double_pawns = count_bits(bitboards[p] & file_masks[square]);
+    __m256i mg_sum = _mm256_setzero_si256();
+    __m256i eg_sum = _mm256_setzero_si256();
 
-                    if (double_pawns > 1){
-                        mg[black] += double_pawns * double_pawn_penalty_opening;
-                        eg[black] += double_pawns * double_pawn_penalty_endgame;
-                    }
-                    if ((bitboards[p] & isolated_masks[square]) == 0){
-                        mg[black] += isolated_pawn_penalty_opening;
-                        eg[black] += isolated_pawn_penalty_endgame;
-                    }
-                    if ((black_passed_masks[square] & bitboards[P]) == 0){
-                        mg[black] += passed_pawn_bonus[get_rank[square]];
-                        eg[black] += passed_pawn_bonus[get_rank[square]];
-                    }
+    for (int piece = P; piece <= k; piece++)
+    {
+        U64 bitboard = pieces(piece);
 
-                    break;
+        if (!bitboard) continue;
 
-                case n: 
-                    mg[black] += mg_table[bb_piece][square];
-                    eg[black] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
-                    break;
-                case b: 
-                    mg[black] += mg_table[bb_piece][square];
-                    eg[black] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
+        for (int chunk = 0; chunk < 4; chunk++)
+        {
+            // expand 16 bits into 16 lane masks
+            __m256i mask = _mm256_set1_epi16((short)((bitboard >> (chunk * 16)) & 0xffff));
+            mask = _mm256_cmpeq_epi16(_mm256_and_si256(mask, bits), bits);
 
-                    mg[black] += (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_opening;
-                    eg[black] += (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_endgame;
-                    break;
-                case r:
-                    
-                    mg[black] += mg_table[bb_piece][square];
-                    eg[black] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
-                    
-                    if ((bitboards[p] & file_masks[square]) == 0){
-                        // add semi open file bonus
-                        mg[black] += semi_open_file_score;
-                        eg[black] += semi_open_file_score;
-                    }
-                    
-                    if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0){
-                        mg[black] += open_file_score;
-                        eg[black] += open_file_score;
-                    }
-                    
-                    break;
-                case q:
-                    mg[black] += mg_table[bb_piece][square];
-                    eg[black] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
+            mg_sum = _mm256_add_epi16(mg_sum, _mm256_and_si256(mask, _mm256_load_si256((__m256i *)&mg_table16[piece][chunk * 16])));
+            eg_sum = _mm256_add_epi16(eg_sum, _mm256_and_si256(mask, _mm256_load_si256((__m256i *)&eg_table16[piece][chunk * 16])));
+        }
+    }
 
-                    mg[black] += (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_opening;
-                    eg[black] += (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_endgame;
-                    break;
-                case k:
-                    mg[black] += mg_table[bb_piece][square];
-                    eg[black] += eg_table[bb_piece][square];
-                    gamePhase += gamephaseInc[bb_piece];
-
-                    if ((bitboards[P] & file_masks[square]) == 0){
-                        mg[white] -= semi_open_file_score;
-                        eg[white] -= semi_open_file_score;
-                    }
-                    
-                    if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0){
-                        mg[white] -= open_file_score;
-                        eg[white] -= open_file_score;
-                    }
+    // widen to 32 bits & reduce
+    __m256i mg_wide = _mm256_madd_epi16(mg_sum, ones);
+    __m256i eg_wide = _mm256_madd_epi16(eg_sum, ones);
+    __m128i mg_half = _mm_add_epi32(_mm256_castsi256_si128(mg_wide), _mm256_extracti128_si256(mg_wide, 1));
+    __m128i eg_half = _mm_add_epi32(_mm256_castsi256_si128(eg_wide), _mm256_extracti128_si256(eg_wide, 1));
+    mg_half = _mm_hadd_epi32(mg_half, eg_half);
+    mg_half = _mm_hadd_epi32(mg_half, mg_half);
 
-                    mg[white] += count_bits(king_attacks[square] & occupancies[white]) * 5;
-                    eg[white] += count_bits(king_attacks[square] & occupancies[white]) * 5;
-                    mg[black] += count_bits(king_attacks[square] & occupancies[black]) * 5;
-                    eg[black] += count_bits(king_attacks[square] & occupancies[black]) * 5;
-                    break;
-            }
-            // pop ls1b
-            pop_bit(bitboard, square);
+    *mg = _mm_cvtsi128_si32(mg_half);
+    *eg = _mm_extract_epi32(mg_half, 1);
+}
+
+// AVX-512 kernel: 32 squares per step, the bitboard itself is the lane mask
+__attribute__((target("avx512f,avx512bw")))
+static void psqt_avx512(int *mg, int *eg)
+{
+    __m512i mg_sum = _mm512_setzero_si512();
+    __m512i eg_sum = _mm512_setzero_si512();
+
+    for (int piece = P; piece <= k; piece++)
+    {
+        U64 bitboard = pieces(piece);
+
+        if (!bitboard) continue;
+
+        for (int chunk = 0; chunk < 2; chunk++)
+        {
+            __mmask32 mask = (__mmask32)(bitboard >> (chunk * 32));
+
+            mg_sum = _mm512_mask_add_epi16(mg_sum, mask, mg_sum, _mm512_load_si512(&mg_table16[piece][chunk * 32]));
+            eg_sum = _mm512_mask_add_epi16(eg_sum, mask, eg_sum, _mm512_load_si512(&eg_table16[piece][chunk * 32]));
         }
     }
 
-    int otherside = (side == white) ? black : white;
+    // widen to 32 bits & reduce
+    *mg = _mm512_reduce_add_epi32(_mm512_madd_epi16(mg_sum, _mm512_set1_epi16(1)));
+    *eg = _mm512_reduce_add_epi32(_mm512_madd_epi16(eg_sum, _mm512_set1_epi16(1)));
+}
+
+#endif
+
+// available PSQT kernels
+typedef struct {
+    char *name;
+    psqt_kernel kernel;
+    int supported;
+} psqt_kernel_info;
+
+psqt_kernel_info psqt_kernels[] = {
+    { "scalar", psqt_scalar, 1 },
+#ifdef USE_X86_SIMD
+    { "sse2", psqt_sse2, 0 },
+    { "avx2", psqt_avx2, 0 },
+    { "avx512", psqt_avx512, 0 },
+#endif
+};
+
+#define PSQT_KERNELS (int)(sizeof(psqt_kernels) / sizeof(psqt_kernels[0]))
+
+// selected PSQT kernel
+psqt_kernel psqt_sum = psqt_scalar;
+char *psqt_kernel_name = "scalar";
 
-    /* tapered eval */
-    int mgScore = mg[side] - mg[otherside];
-    int egScore = eg[side] - eg[otherside];
-    int mgPhase = gamePhase;
-    if (mgPhase > 24) mgPhase = 24; /* in case of early promotion */
-    int egPhase = 24 - mgPhase;
-    return (mgScore * mgPhase + egScore * egPhase) / 24;
+// pick the widest PSQT kernel the CPU supports
+void init_psqt_kernel()
+{
+#ifdef USE_X86_SIMD
+    __builtin_cpu_init();
+
+    psqt_kernels[1].supported = __builtin_cpu_supports("sse2");
+    psqt_kernels[2].supported = __builtin_cpu_supports("avx2");
+    psqt_kernels[3].supported = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+
+    // loop over kernels from the widest one
+    for (int index = PSQT_KERNELS - 1; index >= 0; index--)
+    {
+        if (psqt_kernels[index].supported)
+        {
+            psqt_sum = psqt_kernels[index].kernel;
+            psqt_kernel_name = psqt_kernels[index].name;
+            break;
+        }
+    }
 }
 
-// position evaluation
-static inline int evaluate()
+// game phase (24 with all pieces on board)
+static inline int game_phase()
+{
+    int phase = count_bits(pos.by_type[KNIGHT] | pos.by_type[BISHOP])
+              + count_bits(pos.by_type[ROOK]) * 2
+              + count_bits(pos.by_type[QUEEN]) * 4;
+
+    // in case of early promotion
+    return (phase > 24) ? 24 : phase;
+}
+
+/*
+    Set-wise pawn structure
+
+    Pawn terms are computed for all pawns of a side at once with shifts
+    and file fills (white pawns move towards a8, i.e. to lower squares):
+
+        front span (white)   north fill of the squares ahead
+        doubled              pawns & rear span(pawns)
+        isolated             pawns & ~file fill(adjacent files)
+        passed (white)       pawns & ~front span(black pawns & their attack files)
+*/
+
+// fill bitboard towards rank 8
+static inline U64 north_fill(U64 bitboard)
+{
+    bitboard |= bitboard >> 8;
+    bitboard |= bitboard >> 16;
+    bitboard |= bitboard >> 32;
+
+    return bitboard;
+}
+
+// fill bitboard towards rank 1
+static inline U64 south_fill(U64 bitboard)
+{
+    bitboard |= bitboard << 8;
+    bitboard |= bitboard << 16;
+    bitboard |= bitboard << 32;
+
+    return bitboard;
+}
+
+// fill whole files of the given bitboard
+static inline U64 file_fill(U64 bitboard)
+{
+    return north_fill(bitboard) | south_fill(bitboard);
+}
+
+// squares in front of the pieces from the given side's point of view
+static inline U64 front_span(U64 bitboard, int us)
+{
+    return (us == white) ? north_fill(north_one(bitboard)) : south_fill(south_one(bitboard));
+}
+
+// pawn structure of a single side
+typedef struct {
+    U64 doubled;        // pawns with a friendly pawn ahead on the same file
+    U64 isolated;       // pawns without friendly pawns on adjacent files
+    U64 passed;         // pawns without enemy pawns ahead on the same or adjacent files
+    U64 semi_open;      // files without friendly pawns
+} pawn_structure;
+
+// analyse pawn structure of the given side
+static inline void analyse_pawns(int us, pawn_structure *pawns)
+{
+    U64 our_pawns = pos.by_type[PAWN] & pos.by_color[us];
+    U64 their_pawns = pos.by_type[PAWN] & pos.by_color[us ^ 1];
+
+    // pawns lying in the rear span of other friendly pawns
+    pawns->doubled = our_pawns & front_span(our_pawns, us ^ 1);
+
+    // pawns without friendly neighbour files
+    pawns->isolated = our_pawns & ~file_fill(east_one(our_pawns) | west_one(our_pawns));
+
+    // pawns outside enemy pawns front & attack spans
+    pawns->passed = our_pawns & ~front_span(their_pawns | east_one(their_pawns) | west_one(their_pawns), us ^ 1);
+
+    // files without our pawns
+    pawns->semi_open = ~file_fill(our_pawns);
+}
+
+// evaluate pawn structure of the given side (packed score)
+static inline int evaluate_pawns(int us, pawn_structure *pawns)
 {
-    // static evaluation score
+    // packed score
     int score = 0;
-    
-    // current pieces bitboard copy
+
+    // piece bitboard copy
     U64 bitboard;
-    
-    // init piece & square
-    int piece, square;
-    
-    // penalties
-    int double_pawns = 0;
 
-    int material;
-    
-    // loop over piece bitboards
-    for (int bb_piece = P; bb_piece <= k; bb_piece++)
+    // init square
+    int square;
+
+    // pawn structure
+    score += count_bits(pawns->doubled) * double_pawn_penalty;
+    score += count_bits(pawns->isolated) * isolated_pawn_penalty;
+
+    // passed pawns
+    bitboard = pawns->passed;
+
+    while (bitboard)
     {
-        // init piece bitboard copy
-        bitboard = bitboards[bb_piece];
+        square = get_ls1b_index(bitboard);
+
+        // passed pawn bonus
+        score += passed_pawn_bonus[get_rank[(us == white) ? square : mirror_score[square]]];
+
+        pop_bit(bitboard, square);
+    }
+
+    return score;
+}
+
+// evaluate pieces of the given side: mobility, rook files & king (packed score)
+static inline int evaluate_pieces(int us, pawn_structure *pawns, U64 open_files)
+{
+    // packed score
+    int score = 0;
+
+    // bishop mobility
+    score += (node_piece_mobility(B + us * 6) - bishop_unit * count_bits(pos.by_type[BISHOP] & pos.by_color[us])) * bishop_mobility;
+
+    // rooks on semi open & open files
+    score += count_bits(pos.by_type[ROOK] & pos.by_color[us] & pawns->semi_open) * semi_open_file_score;
+    score += count_bits(pos.by_type[ROOK] & pos.by_color[us] & open_files) * open_file_score;
+
+    // queen mobility
+    score += (node_piece_mobility(Q + us * 6) - queen_unit * count_bits(pos.by_type[QUEEN] & pos.by_color[us])) * queen_mobility;
+
+    // king on semi open & open files
+    U64 king = pos.by_type[KING] & pos.by_color[us];
+
+    if (king & pawns->semi_open)
+        score -= semi_open_file_score;
+
+    if (king & open_files)
+        score -= open_file_score;
+
+    // king shield bonus
+    score += count_bits(king_attacks[get_ls1b_index(king)] & pos.by_color[us]) * king_shield_bonus;
+
+    return score;
+}
+
+// pawn, mobility, rook file & king terms (packed, white's point of view)
+static inline int positional_score()
+{
+    // pawn structure of both sides
+    pawn_structure pawns[2];
+    analyse_pawns(white, &pawns[white]);
+    analyse_pawns(black, &pawns[black]);
+
+    // files without any pawns
+    U64 open_files = pawns[white].semi_open & pawns[black].semi_open;
+
+    return evaluate_pawns(white, &pawns[white]) - evaluate_pawns(black, &pawns[black])
+         + evaluate_pieces(white, &pawns[white], open_files) - evaluate_pieces(black, &pawns[black], open_files);
+}
+
+// taper packed score by game phase & return it from the side to move point of view
+static inline int taper_score(int score, int phase)
+{
+    int tapered = (mg_score(score) * phase + eg_score(score) * (24 - phase)) / 24;
+
+    // flip the sign for black to move
+    return tapered * (1 - 2 * side);
+}
+
+// tapered PeSTO evaluation from the side to move point of view
+static inline int pesto_evaluate()
+{
+    int mg, eg;
+
+    // material & piece-square tables (white - black)
+    psqt_sum(&mg, &eg);
+
+    return taper_score(S(mg, eg) + positional_score(), game_phase());
+}
+
+// larger of the middle & end game parts of a packed score
+#define max_score(score) MAX(mg_score(score), eg_score(score))
+
+/*
+    Lazy evaluation margin
+
+    Upper bound on the piece terms of both sides together, from the
+    largest value every term can reach per piece:
+
+        bishop   (13 - bishop_unit) squares * bishop_mobility
+        queen    (27 - queen_unit) squares * queen_mobility
+        rook     semi open + open file
+        king     8 shield squares (the open file penalty is smaller)
+
+    The lower bounds of these terms are smaller in size, so the bound
+    holds for the white - black difference in both directions.
+*/
+static inline int lazy_eval_margin()
+{
+    return count_bits(pos.by_type[BISHOP]) * (13 - bishop_unit) * max_score(bishop_mobility)
+         + count_bits(pos.by_type[QUEEN]) * (27 - queen_unit) * max_score(queen_mobility)
+         + count_bits(pos.by_type[ROOK]) * (max_score(semi_open_file_score) + max_score(open_file_score))
+         + 2 * 8 * max_score(king_shield_bonus);
+}
+
+#ifdef SEARCH_STATS
+// lazy evaluation statistics
+long lazy_eval_calls, lazy_eval_exits;
+#endif
+
+// evaluate material & PSQT only when that is far outside of the window
+// (the early exit returns a bound of the full evaluation, not the score itself)
+static inline int lazy_evaluate(int alpha, int beta)
+{
+    int mg, eg;
+
+    // material & piece-square tables (white - black)
+    psqt_sum(&mg, &eg);
+
+    // pawn structure of both sides (set-wise, no slider lookups)
+    pawn_structure pawns[2];
+    analyse_pawns(white, &pawns[white]);
+    analyse_pawns(black, &pawns[black]);
+
+    int packed = S(mg, eg) + evaluate_pawns(white, &pawns[white]) - evaluate_pawns(black, &pawns[black]);
+    int phase = game_phase();
+    int score = taper_score(packed, phase);
+    int margin = lazy_eval_margin();
+
+    #ifdef SEARCH_STATS
+    lazy_eval_calls++;
+    #endif
+
+    // piece terms can't bring the score back into the window
+    if (score + margin <= alpha || score - margin >= beta)
+    {
+        #ifdef SEARCH_STATS
+        lazy_eval_exits++;
+        #endif
         
-        // loop over pieces within a bitboard
-        while (bitboard)
-        {
-            // init piece
-            piece = bb_piece;
-            
-            // init square
-            square = get_ls1b_index(bitboard);
-            
-            // score material weights
-            
-            
-            // score positional piece scores
-            switch (piece)
-            {
-                // evaluate white pawns
-                case P:
-                    // positional score
-                    score += pawn_score[square];
-                    material += material_score[PAWN];
-                    // double pawn penalty
-                    //double_pawns = count_bits(bitboards[P] & file_masks[square]);
-                    
-                    // on double pawns (tripple, etc)
-                    /*if (double_pawns > 1)
-                        score += double_pawns * double_pawn_penalty;
-                    
-                    // on isolated pawn
-                    if ((bitboards[P] & isolated_masks[square]) == 0)
-                        // give an isolated pawn penalty
-                        score += isolated_pawn_penalty;
-                    
-                    // on passed pawn
-                    if ((white_passed_masks[square] & bitboards[p]) == 0)
-                        // give passed pawn bonus
-                        score += passed_pawn_bonus[get_rank[square]];*/
+        // upper bound below the window or lower bound above it
+        return (score + margin <= alpha) ? score + margin : score - margin;
+    }
 
-                    break;
-                
-                // evaluate white knights
-                case N:
-                    // positional score
-                    score += knight_score[square];
-                    material += material_score[KNIGHT];
-                    break;
-                
-                // evaluate white bishops
-                case B:
-                    // positional scores
-                    score += bishop_score[square];
-                    material += material_score[BISHOP];
-                    // mobility
-                    //score += count_bits(get_bishop_attacks(square, occupancies[both]));
-                    
-                    break;
-                
-                // evaluate white rooks
-                case R:
-                    // positional score
-                    score += rook_score[square];
-                    material += material_score[ROOK];
-                    // semi open file
-                    /*if ((bitboards[P] & file_masks[square]) == 0)
-                        // add semi open file bonus
-                        score += semi_open_file_score;
-                    
-                    // semi open file
-                    if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)
-                        // add semi open file bonus
-                        score += open_file_score;*/
-                    
-                    break;
-                
-                // evaluate white queens
-                case Q:
-                    score += queen_score[square];
-                    material += material_score[QUEEN];
+    // files without any pawns
+    U64 open_files = pawns[white].semi_open & pawns[black].semi_open;
 
-                    // mobility
-                    //score += count_bits(get_queen_attacks(square, occupancies[both]));
-                    break;
-                
-                // evaluate white king
-                case K:
-                    // posirional score
-                    score += king_score[square];
-                    
-                    // semi open file
-                    // if ((bitboards[P] & file_masks[square]) == 0)
-                    //     // add semi open file penalty
-                    //     score -= semi_open_file_score;
-                    
-                    // // semi open file
-                    // if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)
-                    //     // add semi open file penalty
-                    //     score -= open_file_score;
-                    
-                    // // king safety bonus
-                    // score += count_bits(king_attacks[square] & occupancies[white]) * king_shield_bonus;
-                    break;
+    return taper_score(packed + evaluate_pieces(white, &pawns[white], open_files)
+                              - evaluate_pieces(black, &pawns[black], open_files), phase);
+}
+
+// check that every supported PSQT kernel agrees with the scalar one
+void psqt_self_test()
+{
+    // test positions
+    char *fens[] = { start_position, tricky_position, killer_position, cmk_position, repetitions };
+
+    // positions tested & mismatches found
+    int positions = 0, mismatches = 0;
+
+    // loop over test positions
+    for (int index = 0; index < 5; index++)
+    {
+        parse_fen(fens[index]);
+
+        // random walk from every test position
+        for (int step = 0; step < 200; step++)
+        {
+            int mg, eg, kernel_mg, kernel_eg;
 
-                // evaluate black pawns
-                case p:
-                    // positional score
-                    score -= pawn_score[mirror_score[square]];
-                    material -= material_score[PAWN];
+            // reference sums
+            psqt_scalar(&mg, &eg);
 
-                    // double pawn penalty
-                    /*double_pawns = count_bits(bitboards[p] & file_masks[square]);
-                    
-                    // on double pawns (tripple, etc)
-                    if (double_pawns > 1)
-                        score -= double_pawns * double_pawn_penalty;
-                    
-                    // on isolated pawnd
-                    if ((bitboards[p] & isolated_masks[square]) == 0)
-                        // give an isolated pawn penalty
-                        score -= isolated_pawn_penalty;
-                    
-                    // on passed pawn
-                    if ((black_passed_masks[square] & bitboards[P]) == 0)
-                        // give passed pawn bonus
-                        score -= passed_pawn_bonus[get_rank[mirror_score[square]]];*/
+            // compare against the other kernels
+            for (int kernel = 1; kernel < PSQT_KERNELS; kernel++)
+            {
+                if (!psqt_kernels[kernel].supported) continue;
 
-                    break;
-                
-                // evaluate black knights
-                case n:
-                    // positional score
-                    score -= knight_score[mirror_score[square]];
-                    material -= material_score[KNIGHT];
+                psqt_kernels[kernel].kernel(&kernel_mg, &kernel_eg);
 
-                    break;
-                
-                // evaluate black bishops
-                case b:
-                    // positional score
-                    score -= bishop_score[mirror_score[square]];
-                    material -= material_score[BISHOP];
+                if (kernel_mg != mg || kernel_eg != eg)
+                {
+                    printf("     %s mismatch: mg %d/%d eg %d/%d\n", psqt_kernels[kernel].name, kernel_mg, mg, kernel_eg, eg);
+                    mismatches++;
+                }
+            }
 
-                    
-                    // mobility
-                    //score -= count_bits(get_bishop_attacks(square, occupancies[both]));
-                    break;
-                
-                // evaluate black rooks
-                case r:
-                    // positional score
-                    score -= rook_score[mirror_score[square]];
-                    material -= material_score[ROOK];
-                    
-                    // semi open file
-                    /*if ((bitboards[p] & file_masks[square]) == 0)
-                        // add semi open file bonus
-                        score -= semi_open_file_score;
-                    
-                    // semi open file
-                    if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)
-                        // add semi open file bonus
-                        score -= open_file_score;*/
-                    
-                    break;
-                
-                // evaluate black queens
-                case q:
-                    score -= queen_score[mirror_score[square]];
-                    material -= material_score[QUEEN];
+            positions++;
 
-                    // mobility
+            // make a random legal move
+            moves move_list[1];
+            generate_moves(move_list);
 
-                    //score -= count_bits(get_queen_attacks(square, occupancies[both]));
-                    break;
-                
-                // evaluate black king
-                case k:
-                    // positional score
-                    score -= king_score[mirror_score[square]];
-                    
-                    // semi open file
-                    /*if ((bitboards[p] & file_masks[square]) == 0)
-                        // add semi open file penalty
-                        score += semi_open_file_score;
-                    
-                    // semi open file
-                    if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)
-                        // add semi open file penalty
-                        score += open_file_score;
-                    
-                    // king safety bonus
-                    score -= count_bits(king_attacks[square] & occupancies[black]) * king_shield_bonus;*/
-                    break;
-            }
+            int legal = 0;
 
-            // pop ls1b
-            pop_bit(bitboard, square);
+            for (int tries = 0; tries < 32 && move_list->count && !legal; tries++)
+                legal = make_move(move_list->moves[get_random_U32_number() % move_list->count].move, all_moves);
+
+            // game over, restart from the test position
+            if (!legal) parse_fen(fens[index]);
         }
     }
-    
-    // return final evaluation based on side
-    return (side == white) ? material : -material;
+
+    // print supported kernels
+    printf("     PSQT kernels:");
+
+    for (int kernel = 0; kernel < PSQT_KERNELS; kernel++)
+        if (psqt_kernels[kernel].supported)
+            printf(" %s", psqt_kernels[kernel].name);
+
+    printf(" (using %s)\n", psqt_kernel_name);
+    printf("     Positions: %d  Mismatches: %d\n", positions, mismatches);
+
+    // restore start position
+    parse_fen(start_position);
+}
+
+// position evaluation
+static inline int evaluate()
+{
+    return pesto_evaluate();
 }
 
 
@@ -2736,12 +3305,62 @@ static int mvv_lva[12][12] = {
 };
 
 
-// killer moves [count]
-int killer_moves[2];
+// history scores stay within +/- this (both tables summed fit the 16 bit move list score)
+#define HISTORY_MAX 8000
 
 // history moves [side][from][to]
 int history_moves[2][64][64];
 
+// continuation history [previous piece][previous to][piece][to]
+int continuation_history[12][64][12][64];
+
+// countermoves [previous piece][previous to]
+uint16_t countermoves[12][64];
+
+// add bonus to a history score, the closer the score to HISTORY_MAX the less it grows
+static inline void update_history(int *entry, int bonus)
+{
+    *entry += bonus - *entry * abs(bonus) / HISTORY_MAX;
+}
+
+// history bonus (or penalty) of a move searched at the given depth
+static inline int history_bonus(int depth)
+{
+    return MIN(300 * depth - 250, HISTORY_MAX / 2);
+}
+
+#ifdef SEARCH_STATS
+// move ordering statistics (beta cutoffs in negamax & those by the first move)
+long cutoffs, first_move_cutoffs;
+#endif
+
+// quiet reply that refuted the previous move
+static inline int countermove()
+{
+    return (ply && ss[ply - 1].current_move) ? countermoves[ss[ply - 1].moved_piece][get_move_target(ss[ply - 1].current_move)] : 0;
+}
+
+// history score of a quiet move
+static inline int quiet_history(int move)
+{
+    int score = history_moves[side][get_move_source(move)][get_move_target(move)];
+    
+    // how well the move did as a reply to the previous move
+    if (ply && ss[ply - 1].continuation)
+        score += ss[ply - 1].continuation[get_move_piece(move)][get_move_target(move)];
+    
+    return score;
+}
+
+// remember the move searched at the current ply (before making it)
+static inline void set_current_move(int move)
+{
+    ss[ply].current_move = move;
+    ss[ply].moved_piece = piece_on(get_move_source(move));
+    ss[ply].continuation = continuation_history[ss[ply].moved_piece][get_move_target(move)];
+    ss[ply].reduction = 0;
+}
+
 /*
       ================================
             Triangular PV table
@@ -2768,7 +3387,7 @@ int history_moves[2][64][64];
 int pv_length[64];
 
 // PV table [ply][ply]
-int pv_table[64][64];
+uint16_t pv_table[64][64];
 
 // follow PV & score PV move
 int follow_pv, score_pv;
@@ -2790,11 +3409,11 @@ int follow_pv, score_pv;
 
 // transposition table data structure
 typedef struct {
-    U64 key;   // "almost" unique chess position identifier
-    int depth;      // current search depth
-    int flag;       // flag the type of node (fail-low/fail-high/PV) 
-    int score;
-    int move;      // score (alpha/beta/PV)
+    U64 key;        // "almost" unique chess position identifier
+    int score;      // score (alpha/beta/PV)
+    uint16_t move;  // best move
+    int8_t depth;   // current search depth
+    uint8_t flag;   // flag the type of node (fail-low/fail-high/PV) 
 } ttEntry;               // transposition table (TT aka hash table)
 
 #define HASH_SIZE (16 * 1024 * 1024)/sizeof(ttEntry)
@@ -2848,7 +3467,7 @@ static inline void enable_pv_scoring(moves *move_list)
     for (int count = 0; count < move_list->count; count++)
     {
         // make sure we hit PV move
-        if (pv_table[0][ply] == move_list->moves[count])
+        if (pv_table[0][ply] == move_list->moves[count].move)
         {
             // enable move scoring
             score_pv = 1;
@@ -2859,24 +3478,133 @@ static inline void enable_pv_scoring(moves *move_list)
     }
 }
 
+/*  =======================
+     Static exchange evaluation
+    =======================
+
+    Plays out the capture sequence on the target square with the least
+    valuable attacker first. Sliders hidden behind a capturing piece join
+    in as soon as it leaves the board (x-ray discovery). Pins are ignored.
+*/
+
+// SEE piece values [piece]
+const int see_value[12] = { 100, 320, 330, 500, 900, 0, 100, 320, 330, 500, 900, 0 };
+
+// whether the exchange started by the move wins at least the threshold
+static inline int see(int move, int threshold)
+{
+    // only plain moves are exchanged, others count as even
+    if (get_move_promoted(move) || get_move_enpassant(move) || get_move_castling(move))
+        return 0 >= threshold;
+
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+
+    // init captured piece value
+    int victim = piece_on(target_square);
+    int victim_value = (victim == no_piece) ? 0 : see_value[victim];
+
+    // even winning the victim for free doesn't reach the threshold
+    int swap = victim_value - threshold;
+
+    if (swap < 0)
+        return 0;
+
+    // even losing the moving piece still reaches the threshold
+    swap = see_value[get_move_piece(move)] - swap;
+
+    if (swap <= 0)
+        return 1;
+
+    // occupancy after the move is made
+    U64 occupancy = occupied() ^ (1ULL << source_square) ^ (1ULL << target_square);
+
+    // sliders for x-ray discovery
+    U64 diagonal_sliders = pos.by_type[BISHOP] | pos.by_type[QUEEN];
+    U64 straight_sliders = pos.by_type[ROOK] | pos.by_type[QUEEN];
+
+    // all attackers of the target square
+    U64 attackers = attackers_to(target_square, occupancy);
+
+    // side to recapture
+    int stm = side;
+
+    // result flips with every recapture
+    int result = 1;
+
+    while (1)
+    {
+        stm ^= 1;
+
+        // remove pieces that have already captured
+        attackers &= occupancy;
+
+        // attackers of the side to recapture
+        U64 stm_attackers = attackers & pos.by_color[stm];
+
+        // no recapture available
+        if (!stm_attackers)
+            break;
+
+        result ^= 1;
+
+        // least valuable attacker
+        int piece_type, attacker = 0;
+
+        for (piece_type = PAWN; piece_type < KING; piece_type++)
+        {
+            U64 bitboard = stm_attackers & pos.by_type[piece_type];
+
+            if (bitboard)
+            {
+                attacker = get_ls1b_index(bitboard);
+                break;
+            }
+        }
+
+        // king can only recapture when the opponent has no attackers left
+        if (piece_type == KING)
+            return (attackers & pos.by_color[stm ^ 1]) ? result ^ 1 : result;
+
+        // stand pat once the exchange can't be lost anymore
+        swap = see_value[piece_type] - swap;
+
+        if (swap < result)
+            break;
+
+        // remove the attacker & discover sliders behind it
+        occupancy ^= 1ULL << attacker;
+
+        if (piece_type == PAWN || piece_type == BISHOP || piece_type == QUEEN)
+            attackers |= get_bishop_attacks(target_square, occupancy) & diagonal_sliders;
+
+        if (piece_type == ROOK || piece_type == QUEEN)
+            attackers |= get_rook_attacks(target_square, occupancy) & straight_sliders;
+    }
+
+    return result;
+}
+
 /*  =======================
          Move ordering
     =======================
     
-    1. PV move
-    2. 1st killer move
-    3. 2nd killer move
-    4. Captures in MVV/LVA
-    5. History moves
-    6. Unsorted moves
+    1. TT move
+    2. PV move
+    3. Captures in MVV/LVA
+    4. 1st killer move
+    5. 2nd killer move
+    6. Countermove
+    7. History moves (with continuation history)
+    8. Losing captures (negative SEE) in MVV/LVA
 */
 
 // score moves
-static inline int score_move(int move, int tt_move)
+static inline int score_move(int move, int tt_move, int counter_move)
 {
     
     if (move == tt_move){
-        return 100000;
+        return 30000;
     }
     // if PV move scoring is allowed
     if (score_pv)
@@ -2885,68 +3613,58 @@ static inline int score_move(int move, int tt_move)
         if (pv_table[0][ply] == move)
         {
             score_pv = 0;
-            return 20000;
+            return 29000;
         }
     }
     
     // score capture move
     if (get_move_capture(move))
     {
-        // init target piece
-        int target_piece = P;
-        
-        // pick up bitboard piece index ranges depending on side
-        int start_piece, end_piece;
-        
-        // pick up side to move
-        if (side == white) { start_piece = p; end_piece = k; }
-        else { start_piece = P; end_piece = K; }
-        
-        // loop over bitboards opposite to the current side to move
-        for (int bb_piece = start_piece; bb_piece <= end_piece; bb_piece++)
-        {
-            // if there's a piece on the target square
-            if (get_bit(bitboards[bb_piece], get_move_target(move)))
-            {
-                // remove it from corresponding bitboard
-                target_piece = bb_piece;
-                break;
-            }
-        }
+        // init target piece (enpassant target square is empty)
+        int target_piece = get_move_enpassant(move) ? P : piece_on(get_move_target(move));
                 
         // score move by MVV LVA lookup [source piece][target piece]
-        return mvv_lva[get_move_piece(move)][target_piece] + 10000;
+        if (see(move, 0))
+            return mvv_lva[get_move_piece(move)][target_piece] + 20000;
+        
+        // order losing captures last
+        else
+            return mvv_lva[get_move_piece(move)][target_piece] - 30000;
     }
     
     // score quiet move
     else
     {
         // score 1st killer move
-        if (killer_moves[0] == move)
-            return 9000;
+        if (ss[ply].killers[0] == move)
+            return 19000;
         
         // score 2nd killer move
-        else if (killer_moves[1] == move)
-            return 8000;
+        else if (ss[ply].killers[1] == move)
+            return 18000;
+        
+        // score countermove
+        else if (counter_move == move)
+            return 17000;
         
         // score history move
         else
-            return history_moves[side][get_move_source(move)][get_move_target(move)];
+            return quiet_history(move);
     }
     
     return 0;
 }
 
 // sort moves in descending order
-static inline int sort_moves(moves *move_list, int tt_move)
+static inline void sort_moves(moves *move_list, int tt_move)
 {
-    // move scores
-    int move_scores[256];
+    // refutation of the previous move
+    int counter_move = countermove();
     
     // score all the moves within a move list
     for (int count = 0; count < move_list->count; count++)
         // score move
-        move_scores[count] = score_move(move_list->moves[count], tt_move);
+        move_list->moves[count].score = score_move(move_list->moves[count].move, tt_move, counter_move);
     
     // loop over current move within a move list
     for (int current_move = 0; current_move < move_list->count; current_move++)
@@ -2955,15 +3673,10 @@ static inline int sort_moves(moves *move_list, int tt_move)
         for (int next_move = current_move + 1; next_move < move_list->count; next_move++)
         {
             // compare current and next move scores
-            if (move_scores[current_move] < move_scores[next_move])
+            if (move_list->moves[current_move].score < move_list->moves[next_move].score)
             {
-                // swap scores
-                int temp_score = move_scores[current_move];
-                move_scores[current_move] = move_scores[next_move];
-                move_scores[next_move] = temp_score;
-                
-                // swap moves
-                int temp_move = move_list->moves[current_move];
+                // swap moves together with their scores
+                scored_move temp_move = move_list->moves[current_move];
                 move_list->moves[current_move] = move_list->moves[next_move];
                 move_list->moves[next_move] = temp_move;
             }
@@ -2980,8 +3693,8 @@ void print_move_scores(moves *move_list)
     for (int count = 0; count < move_list->count; count++)
     {
         printf("     move: ");
-        print_move(move_list->moves[count]);
-        printf(" score: %d\n", score_move(move_list->moves[count], 0));
+        print_move(move_list->moves[count].move);
+        printf(" score: %d\n", score_move(move_list->moves[count].move, 0, countermove()));
     }
 }
 
@@ -3001,6 +3714,26 @@ static inline int is_repetition()
     return 0;
 }
 
+// search parameters (UCI options for tuning)
+int rfp_depth = 6;            // reverse futility pruning max depth
+int rfp_margin = 75;          // reverse futility margin per ply
+int razor_depth = 3;          // razoring max depth
+int razor_margin = 250;       // razoring margin per ply
+int futility_depth = 6;       // futility pruning max depth
+int futility_base = 100;      // futility margin base
+int futility_margin = 100;    // futility margin per ply
+int lmp_depth = 8;            // late move pruning max depth
+int lmp_base = 3;             // moves searched before late move pruning
+int iir_depth = 4;            // internal iterative reduction min depth
+int iid = 0;                  // internal iterative deepening instead of reduction
+int se_depth = 8;             // singular extension min depth
+int se_margin = 2;            // singular beta margin per ply below the TT score
+int delta_margin = 200;       // quiescence delta pruning margin
+int probcut_depth = 5;        // ProbCut min depth
+int probcut_margin = 200;     // ProbCut beta margin
+int aspiration_depth = 4;     // first depth searched with an aspiration window
+int aspiration_delta = 25;    // initial aspiration window half width
+
 // quiescence search
 static inline int quiescence(int alpha, int beta)
 {
@@ -3017,58 +3750,99 @@ static inline int quiescence(int alpha, int beta)
         // evaluate position
         return evaluate();
 
-    // evaluate position
-    int evaluation = evaluate();
+    // is king in check
+    int in_check = node_checkers() != 0;
     
-    // fail-hard beta cutoff
-    if (evaluation >= beta)
-    {
-        // node (position) fails high
-        return beta;
-    }
+    int old_alpha = alpha;
+    
+    // TT entry of any depth is deep enough here
+    ttEntry tte = probe_entry(hash_key);
+    int tt_hit = (hash_key == tte.key);
     
-    // found a better move
-    if (evaluation > alpha)
+    if (tt_hit && (tte.flag == FLAG_EXACT || (tte.flag == FLAG_BETA && tte.score >= beta) ||
+                   (tte.flag == FLAG_ALPHA && tte.score <= alpha)))
+        return tte.score;
+    
+    // best score so far & static evaluation (no stand pat in check)
+    int best = -INFINITE, evaluation = -INFINITE;
+    
+    if (!in_check)
     {
-        // PV node (position)
-        alpha = evaluation;
+        // evaluate position (outside of the window this is only a bound on
+        // the stand pat, still safe to fail soft with & to store as such)
+        evaluation = best = lazy_evaluate(alpha, beta);
+        
+        // node (position) fails high
+        if (evaluation >= beta)
+            return evaluation;
+        
+        // found a better move
+        if (evaluation > alpha)
+            // PV node (position)
+            alpha = evaluation;
     }
     
     // create move list instance
     moves move_list[1];
     
-    // generate moves
-    generate_moves(move_list);
+    // generate evasions in check, all moves otherwise
+    if (in_check)
+        generate_evasions(move_list);
+    else
+        generate_moves(move_list);
     
     // sort moves
-    sort_moves(move_list, 0);
+    sort_moves(move_list, tt_hit ? tte.move : 0);
+    
+    int best_move = 0;
+    int legal_moves = 0;
     
     // loop over moves within a movelist
     for (int count = 0; count < move_list->count; count++)
     {
+        int move = move_list->moves[count].move;
+        
+        // out of check every evasion is searched, otherwise captures only
+        if (!in_check)
+        {
+            // skip quiet moves
+            if (!get_move_capture(move))
+                continue;
+            
+            // delta pruning: capture can't raise alpha even with a margin
+            if (!get_move_promoted(move) && !gives_check(move) &&
+                evaluation + see_value[get_move_enpassant(move) ? P : piece_on(get_move_target(move))] + delta_margin <= alpha)
+                continue;
+            
+            // skip captures losing material unless they give check
+            if (!see(move, 0) && !gives_check(move))
+                continue;
+        }
+        
+        set_current_move(move);
+        
         // preserve board state
         copy_board();
         
-        // increment ply
-        ply++;
-        
         // increment repetition index & store hash key
         repetition_index++;
         repetition_table[repetition_index] = hash_key;
 
         
         // make sure to make only legal moves
-        if (make_move(move_list->moves[count], only_captures) == 0)
+        if (make_move(move, all_moves) == 0)
         {
-            // decrement ply
-            ply--;
-            
             // decrement repetition index
             repetition_index--;
             
             // skip to next move
             continue;
         }
+        
+        legal_moves++;
+        
+        // increment ply
+        ply++;
 
         // score current move
         int score = -quiescence(-beta, -alpha);
@@ -3085,25 +3859,41 @@ static inline int quiescence(int alpha, int beta)
         // reutrn 0 if time is up
         if(stopped == 1) return 0;
     
-        if (score > evaluation){
+        // found a better move
+        if (score > best)
+        {
+            best = score;
+            best_move = move;
+            
             if (score > alpha)
             {
                 alpha = score;
+                
+                // node (position) fails high
                 if (score >= beta)
-                {
-                    return beta;
-                }
+                    break;
             }
         }
     }
     
-    // node (position) fails low
-    return alpha;
+    // checkmate
+    if (in_check && legal_moves == 0)
+        return -MATE_VALUE + ply;
+    
+    // store with depth 0 unless that replaces a main search entry
+    if (tte.depth <= 0)
+        store_entry(hash_key, (best >= beta) ? FLAG_BETA : (best > old_alpha) ? FLAG_EXACT : FLAG_ALPHA,
+                    best_move, 0, best);
+    
+    return best;
 }
 
 const int full_depth_moves = 4;
 const int reduction_limit = 3;
 
+// null move cutoffs from this depth on are verified by a normal search
+const int null_verification_depth = 10;
+
 // negamax alpha beta search
 static inline int negamax(int alpha, int beta, int depth, int is_root, int is_null)
 {
@@ -3128,94 +3918,365 @@ static inline int negamax(int alpha, int beta, int depth, int is_root, int is_nu
     // init PV length
     pv_length[ply] = ply;
 
-    // recursion escapre condition
-    if (depth == 0)
+    // recursion escapre condition
+    if (depth == 0)
+    {
+        // run quiescence search
+        return quiescence(alpha, beta);
+        //return evaluate();
+    }
+    
+    int pv_node = beta - alpha > 1;
+    int oldAlpha = alpha;
+    int score;
+
+    // move excluded by a singular extension search of this node
+    int excluded_move = ss[ply].excluded_move;
+
+    // increment nodes count
+    nodes++;
+
+    // is king in check
+    int in_check = ss[ply].in_check = node_checkers() != 0;
+
+    // legal moves counter
+    int legal_moves = 0;
+    
+
+    // number of moves searched in a move list
+    int moves_searched = 0;
+    int best = -999999;
+    int best_move = 0;
+
+    ttEntry tte = probe_entry(hash_key);
+
+    if ((ply != 0) && !excluded_move && (hash_key == tte.key) && (tte.depth >= depth))
+    {
+        if (tte.flag == FLAG_EXACT)
+        {
+            return tte.score;
+        }
+        else if (tte.flag == FLAG_BETA)
+        {
+            alpha = MAX(alpha, tte.score);
+        }
+        else if (tte.flag == FLAG_ALPHA)
+        {
+            beta = MIN(beta, tte.score);
+        }
+        if (alpha >= beta)
+        {
+            return tte.score;
+        }
+    }
+
+    // static eval (only needed out of check, kept for the excluded move search of the same node)
+    int posEval = ss[ply].static_eval = excluded_move ? ss[ply].static_eval : in_check ? -INFINITE : evaluate();
+
+    // static eval is getting better compared to our previous move (or the one before when that was in check)
+    int improving = 0;
+    
+    if (!in_check && ply >= 2)
+    {
+        if (!ss[ply - 2].in_check)
+            improving = posEval > ss[ply - 2].static_eval;
+        else if (ply >= 4 && !ss[ply - 4].in_check)
+            improving = posEval > ss[ply - 4].static_eval;
+    }
+
+    // the previous move was reduced a lot but turns out to be strong: search it a ply deeper
+    if (ply && !in_check && !excluded_move && ss[ply - 1].reduction >= 3 && posEval <= -ss[ply - 1].static_eval - 100)
+        depth++;
+
+    // static eval based pruning (not in PV nodes, in check or close to mate)
+    if (!pv_node && !in_check && ply && !excluded_move && beta > -MATE_SCORE && beta < MATE_SCORE)
+    {
+        // reverse futility pruning: eval beats beta by a depth dependent margin
+        if (depth <= rfp_depth && posEval - rfp_margin * (depth - improving) >= beta)
+            return posEval;
+        
+        // razoring: eval too far below alpha, see if captures can catch up
+        if (depth <= razor_depth && posEval + razor_margin * depth < alpha)
+        {
+            score = quiescence(alpha, alpha + 1);
+            
+            if (score <= alpha)
+                return score;
+        }
+    }
+
+    // null move pruning (not in PV nodes, in check or right after a null move)
+    if (!pv_node && !in_check && is_null && !excluded_move && depth >= 3 && posEval >= beta && beta > -MATE_SCORE && beta < MATE_SCORE &&
+        // zugzwang guard: side to move has more than king & pawns
+        (pos.by_color[side] & ~(pos.by_type[PAWN] | pos.by_type[KING])))
+    {
+        // reduction grows with depth & the eval margin over beta
+        int R = 3 + depth / 4 + MIN((posEval - beta) / 200, 3);
+        int null_depth = MAX(0, depth - 1 - R);
+        int old_enpassant = enpassant;
+        
+        // increment repetition index & store hash key
+        repetition_index++;
+        repetition_table[repetition_index] = hash_key;
+        
+        // no move, continuation history or reduction for the null move
+        ss[ply].current_move = 0;
+        ss[ply].continuation = NULL;
+        ss[ply].reduction = 0;
+        
+        // give the opponent an extra move
+        make_null_move();
+        ply++;
+        
+        score = -negamax(-beta, -beta + 1, null_depth, 0, 0);
+        
+        ply--;
+        unmake_null_move(old_enpassant);
+        
+        // decrement repetition index
+        repetition_index--;
+        
+        // reutrn 0 if time is up
+        if (stopped == 1)
+            return 0;
+        
+        if (score >= beta)
+        {
+            // don't trust mate scores of a null move search
+            if (score >= MATE_SCORE)
+                score = beta;
+            
+            // shallow nodes cut off straight away
+            if (depth < null_verification_depth)
+                return score;
+            
+            // deep nodes verify with a reduced search without null moves
+            int verification = negamax(beta - 1, beta, null_depth, 0, 0);
+            
+            if (stopped == 1)
+                return 0;
+            
+            if (verification >= beta)
+                return score;
+        }
+    }
+
+    // ProbCut: a good capture beating beta by a margin in a reduced search most likely beats beta
+    int probcut_beta = beta + probcut_margin;
+    
+    if (!pv_node && !in_check && !excluded_move && depth >= probcut_depth && abs(beta) < MATE_SCORE &&
+        // TT doesn't already tell the reduced search would fail
+        !(hash_key == tte.key && tte.depth >= depth - 3 && tte.score < probcut_beta))
     {
-        // run quiescence search
-        return quiescence(alpha, beta);
-        //return evaluate();
+        // an earlier ProbCut (or deeper search) already beat the ProbCut beta
+        if (hash_key == tte.key && tte.flag == FLAG_BETA && tte.depth >= depth - 3 && tte.score >= probcut_beta)
+            return tte.score;
+        
+        // create move list instance
+        moves move_list[1];
+        
+        // generate moves
+        generate_moves(move_list);
+        
+        // sort moves (a capture that cut off before goes first)
+        sort_moves(move_list, (hash_key == tte.key) ? tte.move : 0);
+        
+        // loop over captures winning enough material
+        for (int count = 0; count < move_list->count; count++)
+        {
+            int move = move_list->moves[count].move;
+            
+            if (!get_move_capture(move) || !see(move, probcut_beta - posEval))
+                continue;
+            
+            set_current_move(move);
+            
+            // preserve board state
+            copy_board();
+            
+            // increment repetition index & store hash key
+            repetition_index++;
+            repetition_table[repetition_index] = hash_key;
+            
+            // make sure to make only legal moves
+            if (make_move(move, all_moves) == 0)
+            {
+                repetition_index--;
+                continue;
+            }
+            
+            ply++;
+            
+            // quiescence pre-filter, then reduced depth search
+            score = -quiescence(-probcut_beta, -probcut_beta + 1);
+            
+            if (score >= probcut_beta)
+                score = -negamax(-probcut_beta, -probcut_beta + 1, depth - 4, 0, 1);
+            
+            ply--;
+            repetition_index--;
+            take_back();
+            
+            // reutrn 0 if time is up
+            if (stopped == 1)
+                return 0;
+            
+            // cut off & remember it for later visits
+            if (score >= probcut_beta)
+            {
+                store_entry(hash_key, FLAG_BETA, move, depth - 3, score);
+                return score;
+            }
+        }
     }
-    
-    int pv_node = beta - alpha > 1;
-    int oldAlpha = alpha;
-    int score;
-    int posEval = evaluate();
-
-    // increment nodes count
-    nodes++;
 
-    // is king in check
-    int in_check = is_square_attacked((side == white) ? get_ls1b_index(bitboards[K]) : get_ls1b_index(bitboards[k]),
-                                      side ^ 1);
+    // TT move of this position that can be played here
+    int tt_move = (hash_key == tte.key && tte.move != excluded_move && is_pseudo_legal(tte.move)) ? tte.move : 0;
 
-    // increase search depth if the king has been exposed into a check
-    if (in_check){
-        depth++;
+    // no TT move to start with
+    if (!tt_move && !excluded_move && depth >= iir_depth)
+    {
+        // internal iterative deepening: reduced search for a first move
+        if (iid)
+        {
+            negamax(alpha, beta, depth - 2, 0, is_null);
+            
+            // reutrn 0 if time is up
+            if (stopped == 1)
+                return 0;
+            
+            tte = probe_entry(hash_key);
+            tt_move = (hash_key == tte.key && is_pseudo_legal(tte.move)) ? tte.move : 0;
+        }
+        
+        // internal iterative reduction: a node this badly ordered gets one ply less
+        else
+            depth--;
     }
 
-    // legal moves counter
-    int legal_moves = 0;
-    
-
-    // number of moves searched in a move list
-    int moves_searched = 0;
-    int best = -999999;
-
-    ttEntry tte = probe_entry(hash_key);
+    // create move list instance (generated once the TT move fails to cut off)
+    moves move_list[1];
+    move_list->count = 0;
+    int generated = 0;
 
-    if ((ply != 0) && (hash_key == tte.key) && (tte.depth >= depth))
+    // loop over TT move (count -1) & moves within a movelist
+    for (int count = tt_move ? -1 : 0; count < move_list->count || !generated; count++)
     {
-        if (tte.flag == FLAG_EXACT)
+        int move;
+        
+        // TT move before move generation
+        if (count < 0)
+            move = tt_move;
+        
+        else
         {
-            return tte.score;
+            // generate moves on first use
+            if (!generated)
+            {
+                // generate evasions in check, all moves otherwise
+                if (in_check)
+                    generate_evasions(move_list);
+                else
+                    generate_moves(move_list);
+                
+                // if we are now following PV line
+                if (follow_pv)
+                {
+                    // enable PV move scoring
+                    enable_pv_scoring(move_list);
+                }
+                
+                // sort moves
+                sort_moves(move_list, tt_move);
+                
+                generated = 1;
+                
+                // no moves at all
+                if (move_list->count == 0)
+                    break;
+            }
+            
+            move = move_list->moves[count].move;
+            
+            // TT move has been searched already, excluded move is not searched
+            if (move == tt_move || move == excluded_move)
+                continue;
         }
-        else if (tte.flag == FLAG_BETA)
+        
+        // does the move give check & is it quiet (known before making it)
+        int check = gives_check(move);
+        int quiet = !get_move_capture(move) && !get_move_promoted(move);
+        
+        // prune quiet moves once a move avoiding mate has been found
+        if (!pv_node && !in_check && !check && quiet && best > -MATE_SCORE)
         {
-            alpha = MAX(alpha, tte.score);
+            // late move pruning: enough quiet moves searched at low depth
+            if (depth <= lmp_depth && moves_searched >= lmp_base + depth * depth / (2 - improving))
+                continue;
+            
+            // futility pruning: eval too far below alpha for a quiet move to matter
+            if (depth <= futility_depth && posEval + futility_base + futility_margin * depth <= alpha)
+                continue;
         }
-        else if (tte.flag == FLAG_ALPHA)
+        
+        // extension of checking or singular moves
+        int extension = check;
+        
+        // singular extension: TT move with a deep enough lower bound entry
+        if (count < 0 && !is_root && !excluded_move && depth >= se_depth && tte.flag == FLAG_BETA &&
+            tte.depth >= depth - 3 && abs(tte.score) < MATE_SCORE)
         {
-            beta = MIN(beta, tte.score);
+            int singular_beta = tte.score - se_margin * depth;
+            
+            // search the other moves with reduced depth below the TT score
+            ss[ply].excluded_move = move;
+            score = negamax(singular_beta - 1, singular_beta, (depth - 1) / 2, 0, is_null);
+            ss[ply].excluded_move = 0;
+            
+            // reutrn 0 if time is up
+            if (stopped == 1)
+                return 0;
+            
+            // all other moves fail low: TT move is singular
+            if (score < singular_beta)
+                extension = 1;
+            
+            // multi cut: another move beats beta as well
+            else if (singular_beta >= beta)
+                return singular_beta;
         }
-        if (alpha >= beta)
+        
+        // extend checking & singular moves
+        int new_depth = depth - 1 + extension;
+        
+        // late move reduction
+        int reduction = 0;
+        
+        // reduce late quiet moves
+        if (moves_searched >= full_depth_moves && depth >= reduction_limit && !in_check && !check && quiet)
         {
-            return tte.score;
+            int history = quiet_history(move);
+            
+            // less in PV nodes & for moves with a good history, more when not improving
+            reduction = LMRTable[MIN(depth, 63)][MIN(moves_searched, 63)] - pv_node + !improving - history / HISTORY_MAX;
+            
+            // keep at least one ply of search
+            reduction = MAX(0, MIN(reduction, new_depth - 1));
         }
-    }
-
-    // create move list instance
-    moves move_list[1];
-
-    // generate moves
-    generate_moves(move_list);
-    // if we are now following PV line
-    if (follow_pv)
-    {
-        // enable PV move scoring
-        enable_pv_scoring(move_list);
-    }
-    // sort moves
-    sort_moves(move_list, tte.move);
-    // loop over moves within a movelist
-
-    for (int count = 0; count < move_list->count; count++)
-    {
+        
+        set_current_move(move);
+        ss[ply].reduction = reduction;
+        
         // preserve board state
         copy_board();
 
-        // increment ply
-        ply++;
-
         // increment repetition index & store hash key
         repetition_index++;
         repetition_table[repetition_index] = hash_key;
 
         // make sure to make only legal moves
-        if (make_move(move_list->moves[count], all_moves) == 0)
+        if (make_move(move, all_moves) == 0)
         {
-            // decrement ply
-            ply--;
-
             // decrement repetition index
             repetition_index--;
 
@@ -3223,17 +4284,29 @@ static inline int negamax(int alpha, int beta, int depth, int is_root, int is_nu
             continue;
         }
 
+        // increment ply
+        ply++;
+
         // increment legal moves
         legal_moves++;
 
-        // search with full depth but reduced window
-        if (!pv_node || moves_searched > 0){
-            score = -negamax(-alpha-1, -alpha, depth - 1, 0, is_null);
+        // search late moves with reduced depth & window
+        if (reduction)
+        {
+            score = -negamax(-alpha-1, -alpha, new_depth - reduction, 0, 1);
+            
+            // re-searches are not reduced
+            ss[ply - 1].reduction = 0;
+        }
+
+        // search with full depth but reduced window (re-search when the reduced search fails high)
+        if (reduction ? score > alpha : (!pv_node || moves_searched > 0)){
+            score = -negamax(-alpha-1, -alpha, new_depth, 0, 1);
         }
 
         // PVS search.
         if (pv_node && (moves_searched == 0 || (score > alpha && score < beta))){
-            score = -negamax(-beta, -alpha, depth - 1, 0, is_null);
+            score = -negamax(-beta, -alpha, new_depth, 0, 1);
         }
         
         // decrement ply
@@ -3245,9 +4318,9 @@ static inline int negamax(int alpha, int beta, int depth, int is_root, int is_nu
         // take move back
         take_back();
 
-        // reutrn 0 if time is up
-        if (!is_root && stopped == 1) // Dont return 0 if its root
-            return 0;
+        // time is up: the score of an interrupted search is meaningless
+        if (stopped == 1)
+            break;
 
         // increment the counter of moves searched so far
         moves_searched++;
@@ -3255,8 +4328,9 @@ static inline int negamax(int alpha, int beta, int depth, int is_root, int is_nu
         // found a better move
         if (score > best){
             best = score;
+            best_move = move;
             
-            pv_table[ply][ply] = move_list->moves[count];
+            pv_table[ply][ply] = move;
 
             for (int next_ply = ply + 1; next_ply < pv_length[ply + 1]; next_ply++){
                  pv_table[ply][next_ply] = pv_table[ply + 1][next_ply];
@@ -3269,29 +4343,54 @@ static inline int negamax(int alpha, int beta, int depth, int is_root, int is_nu
                 alpha = score;
                 if (score >= beta)
                 {
+                    #ifdef SEARCH_STATS
+                    // move ordering statistics
+                    cutoffs++;
+                    first_move_cutoffs += (moves_searched == 1);
+                    #endif
+                    
                     // on quiet moves
-                    if (get_move_capture(move_list->moves[count]) == 0)
+                    if (get_move_capture(move) == 0)
                     {
                             // store killer moves
-                            killer_moves[1] = killer_moves[0];
-                            killer_moves[0] = move_list->moves[count];
+                            if (ss[ply].killers[0] != move)
+                            {
+                                ss[ply].killers[1] = ss[ply].killers[0];
+                                ss[ply].killers[0] = move;
+                            }
 
                             //store history
-                            history_moves[side][get_move_source(move_list->moves[count])][get_move_target(move_list->moves[count])] += depth*depth;
+                            update_history(&history_moves[side][get_move_source(move)][get_move_target(move)], history_bonus(depth));
+                            
+                            // store continuation history
+                            if (ply && ss[ply - 1].continuation)
+                                update_history(&ss[ply - 1].continuation[ss[ply].moved_piece][get_move_target(move)], history_bonus(depth));
+                            
+                            // store countermove
+                            if (ply && ss[ply - 1].current_move)
+                                countermoves[ss[ply - 1].moved_piece][get_move_target(ss[ply - 1].current_move)] = move;
                     }
                     break;
                 }
             }
         }
-        history_moves[side][get_move_source(move_list->moves[count])][get_move_target(move_list->moves[count])] -= depth*depth;
+        update_history(&history_moves[side][get_move_source(move)][get_move_target(move)], -history_bonus(depth));
         
-        if (is_root && stopped == 1){
-            break;
-        } // if time is up and we are in root, break.
+        // quiet move didn't cut off as a reply to the previous move
+        if (get_move_capture(move) == 0 && ply && ss[ply - 1].continuation)
+            update_history(&ss[ply - 1].continuation[ss[ply].moved_piece][get_move_target(move)], -history_bonus(depth));
     }
 
+    // reutrn 0 if time is up
+    if (stopped == 1)
+        return 0;
+
     if (legal_moves == 0)
     {
+        // only the excluded move is legal
+        if (excluded_move)
+            return alpha;
+        
         if (in_check)
         {
             return -MATE_VALUE + ply;
@@ -3318,11 +4417,39 @@ static inline int negamax(int alpha, int beta, int depth, int is_root, int is_nu
         bound = FLAG_EXACT;
     }
 
-    store_entry(hash_key, bound, pv_table[0][0], depth, best);
+    // excluded move search results don't belong to the position
+    if (!excluded_move)
+        store_entry(hash_key, bound, best_move, depth, best);
     
     return alpha;
 }
 
+// print search info (bound: 0 exact, FLAG_ALPHA upper bound, FLAG_BETA lower bound)
+static void print_search_info(int score, int depth, int bound)
+{
+    const char *bound_string = (bound == FLAG_ALPHA) ? " upperbound" : (bound == FLAG_BETA) ? " lowerbound" : "";
+    
+    if (score > -MATE_VALUE && score < -MATE_SCORE){
+        printf("info score mate %d%s depth %d nodes %ld time %d pv ", -(score + MATE_VALUE) / 2 - 1, bound_string, depth, nodes, get_time_ms() - starttime);
+    }
+    else if (score > MATE_SCORE && score < MATE_VALUE){
+        printf("info score mate %d%s depth %d nodes %ld time %d pv ", (MATE_VALUE - score) / 2 + 1, bound_string, depth, nodes, get_time_ms() - starttime);   
+    
+    }else{
+        printf("info score cp %d%s depth %d nodes %ld time %d pv ", score, bound_string, depth, nodes, get_time_ms() - starttime);
+    }
+    // loop over the moves within a PV line
+    for (int count = 0; count < pv_length[0]; count++)
+    {
+        // print PV move
+        print_move(pv_table[0][count]);
+        printf(" ");
+    }
+    
+    // print new line
+    printf("\n");
+}
+
 // search position for the best move
 void search_position(int depth)
 {
@@ -3332,6 +4459,18 @@ void search_position(int depth)
     // reset nodes counter
     nodes = 0;
     
+    #ifdef SEARCH_STATS
+    // reset lazy evaluation statistics
+    lazy_eval_calls = 0;
+    lazy_eval_exits = 0;
+    #endif
+    
+    #ifdef SEARCH_STATS
+    // reset move ordering statistics
+    cutoffs = 0;
+    first_move_cutoffs = 0;
+    #endif
+    
     // reset "time is up" flag
     stopped = 0;
     
@@ -3345,6 +4484,19 @@ void search_position(int depth)
     memset(pv_length, 0, sizeof(pv_length));
 
     memset(history_moves, 0, sizeof(history_moves));
+    memset(continuation_history, 0, sizeof(continuation_history));
+    memset(countermoves, 0, sizeof(countermoves));
+    
+    // clear search stack (attack cache entries check their own hash keys)
+    for (int index = 0; index <= MAX_PLY; index++)
+    {
+        ss[index].static_eval = -INFINITE;
+        ss[index].in_check = 0;
+        ss[index].excluded_move = 0;
+        ss[index].reduction = 0;
+        ss[index].continuation = NULL;
+    }
+    
     // define initial alpha beta bounds
     int alpha = -INFINITE;
     int beta = INFINITE;
@@ -3359,36 +4511,61 @@ void search_position(int depth)
 			// stop calculating and return best move so far 
 			break;
         }
-        // enable follow PV flag
-        follow_pv = 1;
         
-        killer_moves[0] = 0;
-        killer_moves[1] = 0;
-
+        // clear killers of every ply
+        for (int index = 0; index <= MAX_PLY; index++)
+            ss[index].killers[0] = ss[index].killers[1] = 0;
 
-        // find best move within a given position
-        score = negamax(alpha, beta, current_depth, 1, 1);
+        // aspiration window around the previous score (full window when shallow or mating)
+        int delta = aspiration_delta;
         
-        best_move = pv_table[0][0];
-        if (score > -MATE_VALUE && score < -MATE_SCORE){
-            printf("info score mate %d depth %d nodes %ld time %d pv ", -(score + MATE_VALUE) / 2 - 1, current_depth, nodes, get_time_ms() - starttime);
-        }
-        else if (score > MATE_SCORE && score < MATE_VALUE){
-            printf("info score mate %d depth %d nodes %ld time %d pv ", (MATE_VALUE - score) / 2 + 1, current_depth, nodes, get_time_ms() - starttime);   
+        if (current_depth >= aspiration_depth && abs(score) < MATE_SCORE)
+            alpha = MAX(score - delta, -INFINITE), beta = MIN(score + delta, INFINITE);
+        else
+            alpha = -INFINITE, beta = INFINITE;
         
-        }else{
-            printf("info score cp %d depth %d nodes %ld time %d pv ", score, current_depth, nodes, get_time_ms() - starttime);
-        }
-        // loop over the moves within a PV line
-        for (int count = 0; count < pv_length[0]; count++)
+        // search until the score is inside the window
+        while (1)
         {
-            // print PV move
-            print_move(pv_table[0][count]);
-            printf(" ");
+            // enable follow PV flag
+            follow_pv = 1;
+            
+            // find best move within a given position
+            score = negamax(alpha, beta, current_depth, 1, 1);
+            
+            // interrupted search doesn't tell anything
+            if (stopped == 1)
+                break;
+            
+            // fail low: widen the window down (also when a mate got found)
+            if (score <= alpha && alpha > -INFINITE)
+            {
+                print_search_info(alpha, current_depth, FLAG_ALPHA);
+                beta = (alpha + beta) / 2;
+                alpha = (score <= -MATE_SCORE || delta > 1000) ? -INFINITE : MAX(score - delta, -INFINITE);
+            }
+            
+            // fail high: widen the window up
+            else if (score >= beta && beta < INFINITE)
+            {
+                print_search_info(beta, current_depth, FLAG_BETA);
+                beta = (score >= MATE_SCORE || delta > 1000) ? INFINITE : MIN(score + delta, INFINITE);
+            }
+            
+            // exact score
+            else
+                break;
+            
+            // grow the window exponentially
+            delta += delta / 2;
         }
         
-        // print new line
-        printf("\n");
+        // keep the best move of the last complete iteration
+        if (stopped == 1)
+            break;
+        
+        best_move = pv_table[0][0];
+        print_search_info(score, current_depth, 0);
     }
 
     
@@ -3396,11 +4573,76 @@ void search_position(int depth)
     if (best_move == 0){
         best_move = pv_table[0][0];
     }
+    
+    #ifdef SEARCH_STATS
+    // report lazy evaluation early exits
+    printf("info string lazy eval exits %ld of %ld\n", lazy_eval_exits, lazy_eval_calls);
+    #endif
+    
+    #ifdef SEARCH_STATS
+    // report move ordering quality
+    printf("info string first move cutoffs %ld of %ld\n", first_move_cutoffs, cutoffs);
+    #endif
+    
     printf("bestmove ");
     print_move(best_move);
     printf("\n");
 }
 
+// benchmark positions
+char *bench_positions[] = {
+    start_position,
+    tricky_position,
+    cmk_position,
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1 ",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8 ",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10 "
+};
+
+// perft depth [benchmark position]
+const int bench_perft_depths[] = {5, 4, 4, 5, 4, 4};
+
+// run perft & fixed depth search over the benchmark positions
+void bench(int depth)
+{
+    int positions = sizeof(bench_positions) / sizeof(bench_positions[0]);
+    long perft_nodes = 0, search_nodes = 0;
+    
+    // perft
+    long start = get_time_ms();
+    
+    for (int index = 0; index < positions; index++)
+    {
+        parse_fen(bench_positions[index]);
+        nodes = 0;
+        perft_driver(bench_perft_depths[index]);
+        perft_nodes += nodes;
+    }
+    
+    long perft_time = get_time_ms() - start;
+    
+    // search
+    start = get_time_ms();
+    
+    for (int index = 0; index < positions; index++)
+    {
+        parse_fen(bench_positions[index]);
+        clear_hash_table();
+        search_position(depth);
+        search_nodes += nodes;
+    }
+    
+    long search_time = get_time_ms() - start;
+    
+    printf("\n     Slider attacks: %s\n", slider_backend);
+    printf("      Perft nodes: %ld  time: %ld  nps: %ld\n", perft_nodes, perft_time, perft_nodes * 1000 / (perft_time + 1));
+    printf("     Search nodes: %ld  time: %ld  nps: %ld\n\n", search_nodes, search_time, search_nodes * 1000 / (search_time + 1));
+    
+    // restore start position
+    parse_fen(start_position);
+    clear_hash_table();
+}
+
 /**********************************\
  ==================================
  
@@ -3430,7 +4672,7 @@ int parse_move(char *move_string)
     for (int move_count = 0; move_count < move_list->count; move_count++)
     {
         // init move
-        int move = move_list->moves[move_count];
+        int move = move_list->moves[move_count].move;
         
         // make sure source & target squares are available within the generated move
         if (source_square == get_move_source(move) && target_square == get_move_target(move))
@@ -3654,6 +4896,105 @@ void parse_go(char *command)
     search_position(depth);
 }
 
+// UCI option types (spin or boolean check)
+enum { uci_spin, uci_check };
+
+// UCI option bound to an engine parameter
+typedef struct {
+    const char *name;   // option name
+    int *value;         // engine parameter
+    int type;           // option type
+    int min, max;       // allowed range
+    int default_value;  // parameter value at startup
+} uci_option;
+
+// tunable engine parameters
+uci_option uci_options[] = {
+    {"RFPDepth", &rfp_depth, uci_spin, 0, 20},
+    {"RFPMargin", &rfp_margin, uci_spin, 0, 1000},
+    {"RazorDepth", &razor_depth, uci_spin, 0, 20},
+    {"RazorMargin", &razor_margin, uci_spin, 0, 2000},
+    {"FutilityDepth", &futility_depth, uci_spin, 0, 20},
+    {"FutilityBase", &futility_base, uci_spin, 0, 2000},
+    {"FutilityMargin", &futility_margin, uci_spin, 0, 1000},
+    {"LMPDepth", &lmp_depth, uci_spin, 0, 20},
+    {"LMPBase", &lmp_base, uci_spin, 0, 64},
+    {"IIRDepth", &iir_depth, uci_spin, 2, 64},
+    {"IID", &iid, uci_check, 0, 1},
+    {"SEDepth", &se_depth, uci_spin, 1, 64},
+    {"SEMargin", &se_margin, uci_spin, 0, 100},
+    {"DeltaMargin", &delta_margin, uci_spin, 0, 2000},
+    {"ProbCutDepth", &probcut_depth, uci_spin, 1, 64},
+    {"ProbCutMargin", &probcut_margin, uci_spin, 0, 2000},
+    {"AspirationDepth", &aspiration_depth, uci_spin, 1, 64},
+    {"AspirationDelta", &aspiration_delta, uci_spin, 1, 1000},
+};
+
+// number of UCI options
+#define UCI_OPTIONS (int)(sizeof(uci_options) / sizeof(uci_options[0]))
+
+// remember the startup value of every option as its default
+void init_uci_options()
+{
+    for (int index = 0; index < UCI_OPTIONS; index++)
+        uci_options[index].default_value = *uci_options[index].value;
+}
+
+// print engine info & options
+void print_uci_info()
+{
+    printf("id name %s v%s\n", _ENGINE_NAME, _ENGINE_VERSION);
+    printf("id name %s\n", _ENGINE_AUTHOR);
+    
+    // loop over options
+    for (int index = 0; index < UCI_OPTIONS; index++)
+    {
+        uci_option *option = &uci_options[index];
+        
+        if (option->type == uci_check)
+            printf("option name %s type check default %s\n", option->name, option->default_value ? "true" : "false");
+        else
+            printf("option name %s type spin default %d min %d max %d\n", option->name,
+                   option->default_value, option->min, option->max);
+    }
+    
+    printf("uciok\n");
+}
+
+// parse UCI "setoption name <name> value <value>" command
+void parse_setoption(char *command)
+{
+    // option name & value
+    char *name = strstr(command, "name ");
+    char *value = strstr(command, " value ");
+    
+    // malformed command
+    if (!name || !value)
+        return;
+    
+    name += 5;
+    
+    // loop over options
+    for (int index = 0; index < UCI_OPTIONS; index++)
+    {
+        int length = strlen(uci_options[index].name);
+        
+        // match option name
+        if (value - name == length && !strncmp(name, uci_options[index].name, length))
+        {
+            // check options take "true" or "false"
+            if (uci_options[index].type == uci_check)
+                *uci_options[index].value = strncmp(value + 7, "true", 4) == 0;
+            else
+                *uci_options[index].value = MAX(uci_options[index].min, MIN(uci_options[index].max, atoi(value + 7)));
+            
+            return;
+        }
+    }
+    
+    printf("info string unknown option\n");
+}
+
 // main UCI loop
 void uci_loop()
 {
@@ -3665,9 +5006,7 @@ void uci_loop()
     char input[2000];
     
     // print engine info
-    printf("id name %s v%s\n", _ENGINE_NAME, _ENGINE_VERSION);
-    printf("id name %s\n", _ENGINE_AUTHOR);
-    printf("uciok\n");
+    print_uci_info();
     
     // main loop
     while (1)
@@ -3695,6 +5034,10 @@ void uci_loop()
             continue;
         }
         
+        // parse UCI "setoption" command
+        else if (strncmp(input, "setoption", 9) == 0)
+            parse_setoption(input);
+        
         // parse UCI "position" command
         else if (strncmp(input, "position", 8) == 0)
         {
@@ -3727,9 +5070,18 @@ void uci_loop()
         else if (strncmp(input, "uci", 3) == 0)
         {
             // print engine info
-            printf("id name %s v%s\n", _ENGINE_NAME, _ENGINE_VERSION);
-            printf("id name %s\n", _ENGINE_AUTHOR);
-            printf("uciok\n");
+            print_uci_info();
+        }
+        else if (strncmp(input, "evalcheck", 9) == 0)
+        {
+            psqt_self_test();
+        }
+        else if (strncmp(input, "bench", 5) == 0)
+        {
+            // optional depth ("bench 8"), default 6
+            int depth = atoi(input + 5);
+            
+            bench(depth > 0 ? depth : 6);
         }
         else if (strncmp(input, "eval", 4) == 0)
         {
@@ -3763,6 +5115,7 @@ void init_all()
     // init slider pieces attacks
     init_sliders_attacks(bishop);
     init_sliders_attacks(rook);
+    init_between_squares();
     
     // init magic numbers
     //init_magic_numbers();
@@ -3771,6 +5124,8 @@ void init_all()
     init_random_keys();
     init_evaluation_masks();
     init_tables();
+    init_psqt_kernel();
+    init_uci_options();
 
     // clear hash table
     clear_hash_table();
@@ -3789,10 +5144,26 @@ void init_all()
  ==================================
 \**********************************/
 
-int main()
+int main(int argc, char *argv[])
 {
     // init all
     init_all();
+    
+    // run benchmark from the command line ("out bench [depth]")
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+    {
+        // search polls STDIN for GUI commands, give it one that stays silent
+        int silent[2];
+        
+        if (pipe(silent) == 0)
+            dup2(silent[0], fileno(stdin));
+        
+        int depth = (argc > 2) ? atoi(argv[2]) : 0;
+        
+        bench(depth > 0 ? depth : 6);
+        
+        return 0;
+    }
 
     // debug mode variable
     int debug = 0;